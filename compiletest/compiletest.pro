@@ -9,6 +9,7 @@ TARGET = compiletest
 
 INCLUDEPATH += ../qmccompiler
 INCLUDEPATH += ../qmcloader
+INCLUDEPATH += ../include
 
 LIBS += -L../qmccompiler
 LIBS += -L../qmcloader
@@ -45,6 +46,7 @@ OTHER_FILES += \
     testscript2.js \
     testsubitem2.qml \
     testalias1.qml \
+    testproperties1.qml \
     testcomponent1.qml \
     testsignal1.qml \
     testsignal2.qml \
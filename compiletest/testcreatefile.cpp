@@ -18,17 +18,51 @@
 #include <QTest>
 #include <QQmlComponent>
 #include <QQmlEngine>
+#include <QTextStream>
+#include <QBuffer>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QRegularExpression>
+#include <QResource>
+#include <QProcess>
+#include <QLibraryInfo>
+#include <qqml.h>
 
 #include "testcreatefile.h"
 #include "qmlc.h"
 #include "scriptc.h"
 #include "qmcloader.h"
+#include "qmcpackagewriter.h"
+#include "qmcfile.h"
+#include "qmcmodulefingerprint.h"
 
 #define SUB_ITEM_QMC "SubItem.qmc"
 #define SUB_ITEM_WITH_SCRIPT_QMC "SubItemWithScript.qmc"
+#define SUB_ITEM_CODE_SECTION_QMC "SubItemCodeSection.qmc"
+#define SUB_ITEM_COMPRESSED_QMC "SubItemCompressed.qmc"
+#define SUB_ITEM_CORRUPTED_QMC "SubItemCorrupted.qmc"
+#define SUB_ITEM_CORRUPTED_CODE_QMC "SubItemCorruptedCode.qmc"
+#define SUB_ITEM_OTHER_ARCH_QMC "SubItemOtherArch.qmc"
+#define LARGE_ITEM_QML "LargeItem.qml"
+#define LARGE_ITEM_QMC "LargeItem.qmc"
+#define LARGE_ITEM_COMPACT_QMC "LargeItemCompact.qmc"
+#define LARGE_ITEM_PROPERTIES 300
+#define LARGE_ITEM_TEXT (QString(1000, 'x') + QString::fromUtf8("\xc3\xa4\xe2\x82\xac"))
+#define PACKAGE_DIR "pak"
+#define PACKAGE_FILE "pak/app.qmcpak"
+#define POOLED_PACKAGE_DIR "pool"
+#define POOLED_PACKAGE_FILE "pool/app.qmcpak"
 #define TEST_SCRIPT_1_JSC "testscript1.jsc"
 #define TEST_SCRIPT_2_JSC "testscript2.jsc"
-
+#define TEST_SUB_ITEM_1_QMC "testsubitem1.qmc"
+#define TEST_SUB_ITEM_2_QMC "testsubitem2.qmc"
+#define TEST_COMPONENT_1_QMC "testcomponent1.qmc"
+
+#define MIXED_DIR "mixed"
+#define MIXED_MAIN_QML "mixed/Main.qml"
+#define MIXED_MAIN_QMC "mixed/Main.qmc"
+#define MIXED_SUB_QML "mixed/MixedSub.qml"
+#define MIXED_SUB_QMC "mixed/MixedSub.qmc"
 #define TEST_MOD_1_QMC "testmod1.qmc"
 
 #define TEST_MOD_2_QMC "testmod2.qmc"
@@ -64,6 +98,378 @@ void TestCreateFile::testLoadSingleFile()
     delete engine;
 }
 
+/*
+ * Same as above, but reading the file instead of mapping it
+ */
+void TestCreateFile::testLoadSingleFileWithoutMapping()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    loader.setFileMappingEnabled(false);
+    QVERIFY(!loader.isFileMappingEnabled());
+    QQmlComponent *c = loader.loadComponent(tempDirPath(SUB_ITEM_QMC));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVariant var = obj->property("height");
+    QVERIFY(!var.isNull());
+    QVERIFY(var.toInt() == 20);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Files are read in worker threads, components created in this thread
+ */
+void TestCreateFile::testLoadAsync()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    QSignalSpy spy(&loader, SIGNAL(componentLoaded(QString,QQmlComponent*)));
+    loader.loadComponentAsync(tempDirPath(SUB_ITEM_QMC));
+    loader.loadComponentAsync(tempDirPath("NonExisting.qmc"));
+    while (spy.count() < 2)
+        QVERIFY(spy.wait());
+
+    bool loaded = false;
+    bool failed = false;
+    foreach (const QList<QVariant> &args, spy) {
+        QQmlComponent *c = qvariant_cast<QQmlComponent *>(args.at(1));
+        if (args.at(0).toString() != tempDirPath(SUB_ITEM_QMC)) {
+            QVERIFY(!c);
+            failed = true;
+            continue;
+        }
+        QVERIFY(c);
+        QObject *obj = c->create();
+        QVERIFY(obj);
+        QVERIFY(obj->property("height").toInt() == 20);
+        delete obj;
+        delete c;
+        loaded = true;
+    }
+    QVERIFY(loaded && failed);
+    delete engine;
+}
+
+/*
+ * Position independent code in page aligned section, mapped and read
+ */
+void TestCreateFile::testLoadCodeSection()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    for (int i = 0; i < 2; i++) {
+        loader.setFileMappingEnabled(i == 0);
+        QQmlComponent *c = loader.loadComponent(tempDirPath(SUB_ITEM_CODE_SECTION_QMC));
+        QVERIFY(c);
+        QObject *obj = c->create();
+        QVariant var = obj->property("height");
+        QVERIFY(!var.isNull());
+        QVERIFY(var.toInt() == 20);
+        delete obj;
+        delete c;
+    }
+    delete engine;
+}
+
+/*
+ * Unit compiled to memory and loaded from a stream
+ */
+void TestCreateFile::testCompileToMemory()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmlC qmlc(engine);
+    qmlc.setBasePath("");
+    QByteArray data;
+    QVERIFY(qmlc.compile("qrc:/testqml/SubItem.qml", data));
+    QVERIFY(!data.isEmpty());
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    QDataStream stream(&buffer);
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent(stream, QUrl("qrc:/testqml/SubItem.qmc"));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVariant var = obj->property("height");
+    QVERIFY(!var.isNull());
+    QVERIFY(var.toInt() == 20);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Unit is used in place from a buffer owned by the caller
+ */
+void TestCreateFile::testLoadFromBuffer()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmlC qmlc(engine);
+    qmlc.setBasePath("");
+    QByteArray data;
+    QVERIFY(qmlc.compile("qrc:/testqml/SubItem.qml", data));
+    QVERIFY(!data.isEmpty());
+
+    QmcLoader loader(engine);
+    QVERIFY(!loader.loadComponent((const uchar *)data.constData(), 8, QUrl("qrc:/testqml/SubItem.qmc")));
+    QQmlComponent *c = loader.loadComponent((const uchar *)data.constData(), data.size(),
+                                            QUrl("qrc:/testqml/SubItem.qmc"));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVariant var = obj->property("height");
+    QVERIFY(!var.isNull());
+    QVERIFY(var.toInt() == 20);
+    delete obj;
+    delete c;
+
+    // misaligned buffer, the parts used in place are copied
+    QByteArray misaligned(data.size() + 1, 0);
+    memcpy(misaligned.data() + 1, data.constData(), data.size());
+    c = loader.loadComponent((const uchar *)misaligned.constData() + 1, data.size(),
+                             QUrl("qrc:/testqml/SubItem.qmc"));
+    QVERIFY(c);
+    obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("height").toInt() == 20);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Units and packages in resources, uncompressed ones are used in place
+ */
+void TestCreateFile::testLoadFromResource()
+{
+    QFile qrc(tempDirPath("units.qrc"));
+    QVERIFY(qrc.open(QFile::WriteOnly));
+    qrc.write("<RCC><qresource prefix=\"/\">"
+              "<file>" SUB_ITEM_QMC "</file><file>" PACKAGE_FILE "</file>"
+              "</qresource></RCC>");
+    qrc.close();
+
+    const QString rcc = QLibraryInfo::location(QLibraryInfo::BinariesPath) + "/rcc";
+    const char *roots[] = { "/plain", "/compressed" };
+    QStringList options[2];
+    options[0] << "-no-compress";
+    options[1] << "-compress" << "9" << "-threshold" << "0";
+    for (int i = 0; i < 2; i++) {
+        const QString rccFile = tempDirPath(QString("units%1.rcc").arg(i));
+        QProcess process;
+        process.setWorkingDirectory(tempDirPath(""));
+        process.start(rcc, QStringList() << "-binary" << options[i] << "units.qrc" << "-o" << rccFile);
+        if (!process.waitForFinished() || process.exitCode() != 0)
+            QSKIP("rcc is not available");
+        QVERIFY(QResource::registerResource(rccFile, roots[i]));
+    }
+    QVERIFY(!QResource(":/plain/" SUB_ITEM_QMC).isCompressed());
+    QVERIFY(QResource(":/compressed/" SUB_ITEM_QMC).isCompressed());
+
+    for (int i = 0; i < 2; i++) {
+        const QString root = QString(":") + roots[i];
+        QQmlEngine *engine = new QQmlEngine;
+        QmcLoader loader(engine);
+        QQmlComponent *c = loader.loadComponent(root + "/" SUB_ITEM_QMC);
+        QVERIFY(c);
+        QObject *obj = c->create();
+        QVERIFY(obj);
+        QVERIFY(obj->property("height").toInt() == 20);
+        delete obj;
+        delete c;
+
+        QVERIFY(loader.addPackage(root + "/" PACKAGE_FILE));
+        c = loader.loadComponent(root + "/" PACKAGE_DIR "/" SUB_ITEM_CODE_SECTION_QMC);
+        QVERIFY(c);
+        obj = c->create();
+        QVERIFY(obj);
+        QVERIFY(obj->property("height").toInt() == 20);
+        delete obj;
+        delete c;
+        delete engine;
+    }
+
+    for (int i = 0; i < 2; i++)
+        QVERIFY(QResource::unregisterResource(tempDirPath(QString("units%1.rcc").arg(i)), roots[i]));
+}
+
+/*
+ * Unit registered as qmc --emit-cpp does, it is found before any file
+ */
+void TestCreateFile::testLoadStaticUnit()
+{
+    // stays valid for the rest of the process like data in the binary
+    static QByteArray data;
+    QQmlEngine *engine = new QQmlEngine;
+    QmlC qmlc(engine);
+    qmlc.setBasePath("");
+    QVERIFY(qmlc.compile("qrc:/testqml/SubItem.qml", data));
+    QmcLoader::registerStaticUnit(":/static/SubItem.qmc", (const uchar *)data.constData(), data.size());
+
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent(":/static/SubItem.qmc");
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVariant var = obj->property("height");
+    QVERIFY(!var.isNull());
+    QVERIFY(var.toInt() == 20);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Compressed sections, including the code section
+ */
+void TestCreateFile::testLoadCompressed()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent(tempDirPath(SUB_ITEM_COMPRESSED_QMC));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVariant var = obj->property("height");
+    QVERIFY(!var.isNull());
+    QVERIFY(var.toInt() == 20);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Changed byte in the last section or in the code section is caught by the
+ * section checksums, the code section only when it is linked
+ */
+void TestCreateFile::testLoadCorrupted()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent(tempDirPath(SUB_ITEM_CORRUPTED_QMC));
+    QVERIFY(!c);
+    QVERIFY(!loader.errors().isEmpty());
+    c = loader.loadComponent(tempDirPath(SUB_ITEM_CORRUPTED_CODE_QMC));
+    QVERIFY(!c);
+    QVERIFY(!loader.errors().isEmpty());
+    delete engine;
+}
+
+/*
+ * Code of other architectures is neither generated nor loaded
+ */
+void TestCreateFile::testOtherArchitecture()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent(tempDirPath(SUB_ITEM_OTHER_ARCH_QMC));
+    QVERIFY(!c);
+    QVERIFY(!loader.errors().isEmpty());
+
+    QmlC qmlc(engine);
+    const QString host = qmlc.targetArchitecture();
+    QVERIFY(!qmlc.setTargetArchitecture("pdp11"));
+    QVERIFY(qmlc.targetArchitecture() == host);
+    QVERIFY(qmlc.setTargetArchitecture(host == "armv7" ? "x86_64" : "armv7"));
+    QByteArray data;
+    QVERIFY(!qmlc.compile("qrc:/testqml/SubItem.qml", data));
+    QVERIFY(qmlc.isError());
+    delete engine;
+}
+
+/*
+ * Unit with more strings, code refs and longer strings than the old fixed limits
+ */
+void TestCreateFile::testLoadLargeUnit()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent(tempDirPath(LARGE_ITEM_QMC));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVERIFY(obj);
+    QVariant var = obj->property(QString("p%1").arg(LARGE_ITEM_PROPERTIES - 1).toLatin1());
+    QVERIFY(!var.isNull());
+    QVERIFY(var.toInt() == LARGE_ITEM_PROPERTIES - 1);
+    var = obj->property("text");
+    QVERIFY(!var.isNull());
+    QVERIFY(var.toString() == LARGE_ITEM_TEXT);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Varint tables give the same unit in less space
+ */
+void TestCreateFile::testLoadCompactTables()
+{
+    QVERIFY(QFileInfo(tempDirPath(LARGE_ITEM_COMPACT_QMC)).size() < QFileInfo(tempDirPath(LARGE_ITEM_QMC)).size());
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent(tempDirPath(LARGE_ITEM_COMPACT_QMC));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVERIFY(obj);
+    for (int i = 0; i < LARGE_ITEM_PROPERTIES; i += LARGE_ITEM_PROPERTIES / 10) {
+        QVariant var = obj->property(QString("p%1").arg(i).toLatin1());
+        QVERIFY(!var.isNull());
+        QVERIFY(var.toInt() == i);
+    }
+    QVERIFY(obj->property("text").toString() == LARGE_ITEM_TEXT);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Units that exist only inside a package, mapped and read
+ */
+void TestCreateFile::testLoadPackage()
+{
+    for (int i = 0; i < 2; i++) {
+        QQmlEngine *engine = new QQmlEngine;
+        QmcLoader loader(engine);
+        loader.setFileMappingEnabled(i == 0);
+        QVERIFY(!loader.loadComponent(tempDirPath(PACKAGE_DIR "/" SUB_ITEM_QMC)));
+        QVERIFY(loader.addPackage(tempDirPath(PACKAGE_FILE)));
+        const char *files[] = { SUB_ITEM_QMC, SUB_ITEM_CODE_SECTION_QMC };
+        for (int j = 0; j < 2; j++) {
+            QQmlComponent *c = loader.loadComponent(tempDirPath(QString(PACKAGE_DIR "/") + files[j]));
+            QVERIFY(c);
+            QObject *obj = c->create();
+            QVariant var = obj->property("height");
+            QVERIFY(!var.isNull());
+            QVERIFY(var.toInt() == 20);
+            delete obj;
+            delete c;
+        }
+        delete engine;
+    }
+}
+
+/*
+ * Units of the package share its pool of constants and strings and cannot
+ * be loaded without it
+ */
+void TestCreateFile::testLoadPooledPackage()
+{
+    for (int i = 0; i < 2; i++) {
+        QQmlEngine *engine = new QQmlEngine;
+        QmcLoader loader(engine);
+        loader.setFileMappingEnabled(i == 0);
+        QVERIFY(!loader.loadComponent(tempDirPath(POOLED_PACKAGE_DIR "/" SUB_ITEM_QMC)));
+        QVERIFY(loader.addPackage(tempDirPath(POOLED_PACKAGE_FILE)));
+        QQmlComponent *c = loader.loadComponent(tempDirPath(POOLED_PACKAGE_DIR "/" SUB_ITEM_WITH_SCRIPT_QMC));
+        QVERIFY(c);
+        QObject *obj = c->create();
+        QVERIFY(obj);
+        QVERIFY(obj->property("height").toInt() == 40);
+        delete obj;
+        delete c;
+        delete engine;
+    }
+}
+
 /*
  * This is test case that loads dependency automatically. Both success and fail case.
  */
@@ -87,6 +493,165 @@ void TestCreateFile::testLoadDependency()
     delete engine;
 }
 
+/*
+ * Composite type and script listed in the units are read in parallel
+ */
+void TestCreateFile::testLoadDependencyList()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent(tempDirPath(TEST_SUB_ITEM_1_QMC));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("height").toInt() == 20);
+    delete obj;
+    delete c;
+    c = loader.loadComponent(tempDirPath(SUB_ITEM_WITH_SCRIPT_QMC));
+    QVERIFY(c);
+    obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("height").toInt() == 40);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Script of the composite type is listed in the root unit and prefetched
+ * with the type
+ */
+void TestCreateFile::testLoadTransitiveDependencies()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent(tempDirPath(TEST_SUB_ITEM_2_QMC));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("height").toInt() == 40);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Same files loaded by two engines share the file data and position
+ * independent code, which must outlive the engine that loaded it first
+ */
+void TestCreateFile::testLoadSharedUnit()
+{
+    QStringList files;
+    files << SUB_ITEM_QMC << SUB_ITEM_CODE_SECTION_QMC << SUB_ITEM_COMPRESSED_QMC;
+    foreach (const QString &file, files) {
+        QQmlEngine *engine1 = new QQmlEngine;
+        QmcLoader *loader1 = new QmcLoader(engine1);
+        QQmlComponent *c1 = loader1->loadComponent(tempDirPath(file));
+        QVERIFY(c1);
+        QQmlEngine *engine2 = new QQmlEngine;
+        QmcLoader loader2(engine2);
+        QQmlComponent *c2 = loader2.loadComponent(tempDirPath(file));
+        QVERIFY(c2);
+        delete c1;
+        delete loader1;
+        delete engine1;
+        QObject *obj = c2->create();
+        QVERIFY(obj);
+        QVERIFY(obj->property("height").toInt() == 20);
+        delete obj;
+        delete c2;
+        delete engine2;
+    }
+}
+
+/*
+ * Functions of inline components and imported scripts are linked when
+ * they are first called
+ */
+void TestCreateFile::testLoadLazyLinking()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    QmcLoader loader(engine);
+    QVERIFY(!loader.isLazyLinkingEnabled());
+    loader.setLazyLinkingEnabled(true);
+    QQmlComponent *c = loader.loadComponent(tempDirPath(SUB_ITEM_WITH_SCRIPT_QMC));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("height").toInt() == 40);
+    delete obj;
+    delete c;
+
+    c = loader.loadComponent(tempDirPath(TEST_COMPONENT_1_QMC));
+    QVERIFY(c);
+    obj = c->create();
+    QVERIFY(obj);
+    QVariant ret;
+    QMetaObject::invokeMethod(obj, "getSubWidth1", Q_RETURN_ARG(QVariant, ret));
+    QVERIFY(ret.toInt() == 10);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
+/*
+ * Precompiled unit using a type that only has its source
+ */
+void TestCreateFile::testLoadSourceFallback()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    {
+        QmcLoader loader(engine);
+        QVERIFY(!loader.isSourceFallbackEnabled());
+        QVERIFY(!loader.loadComponent(tempDirPath(MIXED_MAIN_QMC)));
+    }
+
+    QmcLoader loader(engine);
+    loader.setSourceFallbackEnabled(true);
+    QQmlComponent *c = loader.loadComponent(tempDirPath(MIXED_MAIN_QMC));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("width").toInt() == 30);
+    delete obj;
+    delete c;
+
+    // no precompiled file, the engine compiles the source
+    c = loader.loadSource(QUrl::fromLocalFile(tempDirPath(MIXED_SUB_QML)));
+    QVERIFY(c);
+    obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("width").toInt() == 30);
+    delete obj;
+    delete c;
+
+    c = loader.loadSource(QUrl::fromLocalFile(tempDirPath(MIXED_MAIN_QML)));
+    QVERIFY(c);
+    obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("width").toInt() == 30);
+    delete obj;
+    delete c;
+
+    // broken precompiled file is reported and the source is used
+    QFile mainQmc(tempDirPath(MIXED_MAIN_QMC));
+    QVERIFY(mainQmc.open(QFile::ReadOnly));
+    QFile subQmc(tempDirPath(MIXED_SUB_QMC));
+    QVERIFY(subQmc.open(QFile::WriteOnly));
+    subQmc.write(mainQmc.read(16));
+    subQmc.close();
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Precompiled file rejected"));
+    c = loader.loadSource(QUrl::fromLocalFile(tempDirPath(MIXED_SUB_QML)));
+    QVERIFY(QFile::remove(tempDirPath(MIXED_SUB_QMC)));
+    QVERIFY(c);
+    obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("width").toInt() == 30);
+    delete obj;
+    delete c;
+    delete engine;
+}
+
 void TestCreateFile::testLoadModule1()
 {
     QQmlEngine *engine = new QQmlEngine;
@@ -128,6 +693,42 @@ void TestCreateFile::testLoadModule2()
     delete engine;
 }
 
+/*
+ * Type resolutions of the compiler are not used once a type is registered
+ * to an imported module, the types are resolved by name again
+ */
+void TestCreateFile::testModuleFingerprintMismatch()
+{
+    qmlRegisterType<QObject>("QmcFingerprintTest", 1, 0, "Probe");
+    QFile source(tempDirPath("Fingerprint.qml"));
+    QVERIFY(source.open(QFile::WriteOnly));
+    source.write("import QtQuick 2.0\nimport QmcFingerprintTest 1.0\n"
+                 "Item { width: 10; property QtObject probe: Probe {} }\n");
+    source.close();
+
+    QQmlEngine *engine = new QQmlEngine;
+    QmlC qmlc(engine);
+    QByteArray data;
+    QVERIFY(qmlc.compile(QUrl::fromLocalFile(tempDirPath("Fingerprint.qml")).toString(), data));
+    const QByteArray before = QmcModuleFingerprint::importData("QmcFingerprintTest", 1);
+
+    // same highest minor version, only the types differ
+    qmlRegisterType<QObject>("QmcFingerprintTest", 1, 0, "Extra");
+    QVERIFY(QmcModuleFingerprint::importData("QmcFingerprintTest", 1) != before);
+
+    QmcLoader loader(engine);
+    QQmlComponent *c = loader.loadComponent((const uchar *)data.constData(), data.size(),
+                                            QUrl::fromLocalFile(tempDirPath("Fingerprint.qmc")));
+    QVERIFY(c);
+    QObject *obj = c->create();
+    QVERIFY(obj);
+    QVERIFY(obj->property("width").toInt() == 10);
+    QVERIFY(obj->property("probe").value<QObject *>());
+    delete obj;
+    delete c;
+    delete engine;
+}
+
 void TestCreateFile::initTestCase()
 {
     tempDir = new QTemporaryDir;
@@ -152,12 +753,130 @@ void TestCreateFile::initTestCase()
     QVERIFY(ret);
     ret = qmlc.compile("qrc:/testqml/SubItemWithScript.qml", tempDirPath(SUB_ITEM_WITH_SCRIPT_QMC));
     QVERIFY(ret);
+    ret = qmlc.compile("qrc:/testqml/testsubitem1.qml", tempDirPath(TEST_SUB_ITEM_1_QMC));
+    QVERIFY(ret);
+    ret = qmlc.compile("qrc:/testqml/testsubitem2.qml", tempDirPath(TEST_SUB_ITEM_2_QMC));
+    QVERIFY(ret);
+    ret = qmlc.compile("qrc:/testqml/testcomponent1.qml", tempDirPath(TEST_COMPONENT_1_QMC));
+    QVERIFY(ret);
+
+    qmlc.setPositionIndependentCode(true);
+    qmlc.setCodeSection(true);
+    ret = qmlc.compile("qrc:/testqml/SubItem.qml", tempDirPath(SUB_ITEM_CODE_SECTION_QMC));
+    QVERIFY(ret);
+    qmlc.setCompression(true);
+    ret = qmlc.compile("qrc:/testqml/SubItem.qml", tempDirPath(SUB_ITEM_COMPRESSED_QMC));
+    QVERIFY(ret);
+    qmlc.setCompression(false);
+    qmlc.setPositionIndependentCode(false);
+    qmlc.setCodeSection(false);
+
+    QFile original(tempDirPath(SUB_ITEM_QMC));
+    QVERIFY(original.open(QFile::ReadOnly));
+    QByteArray corrupted = original.readAll();
+    QVERIFY(!corrupted.isEmpty());
+    corrupted[corrupted.size() - 1] = corrupted[corrupted.size() - 1] ^ 0x1;
+    QFile corruptedFile(tempDirPath(SUB_ITEM_CORRUPTED_QMC));
+    QVERIFY(corruptedFile.open(QFile::WriteOnly));
+    QVERIFY(corruptedFile.write(corrupted) == corrupted.size());
+    corruptedFile.close();
+
+    // intact unit tagged with another architecture
+    QByteArray otherArch = corrupted;
+    otherArch[otherArch.size() - 1] = otherArch[otherArch.size() - 1] ^ 0x1;
+    QmcUnitHeader *otherArchHeader = (QmcUnitHeader *)otherArch.data();
+    otherArchHeader->architecture = otherArchHeader->architecture == QMC_ARCH_ARMV7 ? QMC_ARCH_X86_64 : QMC_ARCH_ARMV7;
+    QFile otherArchFile(tempDirPath(SUB_ITEM_OTHER_ARCH_QMC));
+    QVERIFY(otherArchFile.open(QFile::WriteOnly));
+    QVERIFY(otherArchFile.write(otherArch) == otherArch.size());
+    otherArchFile.close();
+
+    // changed byte in the code section, which is checked when linked
+    QFile codeSectionFile(tempDirPath(SUB_ITEM_CODE_SECTION_QMC));
+    QVERIFY(codeSectionFile.open(QFile::ReadOnly));
+    QByteArray corruptedCode = codeSectionFile.readAll();
+    const QmcUnitHeader *codeHeader = (const QmcUnitHeader *)corruptedCode.constData();
+    QVERIFY(codeHeader->flags & QMC_UNIT_FLAG_CODE_SECTION);
+    int directoryOffset = sizeof(QmcUnitHeader);
+    directoryOffset += (Q_ALIGNOF(QmcUnitSectionDirectory) - directoryOffset % Q_ALIGNOF(QmcUnitSectionDirectory)) % Q_ALIGNOF(QmcUnitSectionDirectory);
+    int sectionsOffset = directoryOffset + sizeof(QmcUnitSectionDirectory);
+    sectionsOffset += (Q_ALIGNOF(QmcUnitSection) - sectionsOffset % Q_ALIGNOF(QmcUnitSection)) % Q_ALIGNOF(QmcUnitSection);
+    const QmcUnitSectionDirectory *directory = (const QmcUnitSectionDirectory *)(corruptedCode.constData() + directoryOffset);
+    const QmcUnitSection *codeSection = NULL;
+    for (quint32 i = 0; i < directory->sections; i++) {
+        const QmcUnitSection *section = (const QmcUnitSection *)(corruptedCode.constData() + sectionsOffset) + i;
+        if (section->id == QMC_SECTION_CODE)
+            codeSection = section;
+    }
+    QVERIFY(codeSection && codeSection->size > 0);
+    corruptedCode[int(codeSection->offset + codeSection->size / 2)] = corruptedCode[int(codeSection->offset + codeSection->size / 2)] ^ 0x1;
+    QFile corruptedCodeFile(tempDirPath(SUB_ITEM_CORRUPTED_CODE_QMC));
+    QVERIFY(corruptedCodeFile.open(QFile::WriteOnly));
+    QVERIFY(corruptedCodeFile.write(corruptedCode) == corruptedCode.size());
+    corruptedCodeFile.close();
+
+    // each property has its own name string and binding function
+    QFile largeItem(tempDirPath(LARGE_ITEM_QML));
+    QVERIFY(largeItem.open(QFile::WriteOnly));
+    QTextStream largeItemStream(&largeItem);
+    largeItemStream.setCodec("UTF-8");
+    largeItemStream << "import QtQuick 2.0\nItem {\n";
+    largeItemStream << "    property string text: \"" << LARGE_ITEM_TEXT << "\"\n";
+    for (int i = 0; i < LARGE_ITEM_PROPERTIES; i++)
+        largeItemStream << "    property int p" << i << ": " << i << " + width\n";
+    largeItemStream << "}\n";
+    largeItemStream.flush();
+    largeItem.close();
+    ret = qmlc.compile(QUrl::fromLocalFile(tempDirPath(LARGE_ITEM_QML)).toString(), tempDirPath(LARGE_ITEM_QMC));
+    QVERIFY(ret);
+    qmlc.setCompactTables(true);
+    ret = qmlc.compile(QUrl::fromLocalFile(tempDirPath(LARGE_ITEM_QML)).toString(), tempDirPath(LARGE_ITEM_COMPACT_QMC));
+    QVERIFY(ret);
+    qmlc.setCompactTables(false);
+
+    // package in its own directory, so its units cannot be found as files
+    ret = dir.mkdir(PACKAGE_DIR);
+    QVERIFY(ret);
+    QmcPackageWriter writer;
+    ret = writer.addFile(SUB_ITEM_QMC, tempDirPath(SUB_ITEM_QMC));
+    QVERIFY(ret);
+    ret = writer.addFile(SUB_ITEM_CODE_SECTION_QMC, tempDirPath(SUB_ITEM_CODE_SECTION_QMC));
+    QVERIFY(ret);
+    ret = writer.write(tempDirPath(PACKAGE_FILE));
+    QVERIFY(ret);
 
     ret = scriptc.compile("qrc:/testqml/testscript1.js", tempDirPath(TEST_SCRIPT_1_JSC));
     QVERIFY(ret);
     ret = scriptc.compile("qrc:/testqml/testscript2.js", tempDirPath(TEST_SCRIPT_2_JSC));
     QVERIFY(ret);
 
+    // units compiled with the pool of the package, the pooled unit written
+    // as file cannot be loaded
+    ret = dir.mkdir(POOLED_PACKAGE_DIR);
+    QVERIFY(ret);
+    QmcPackageWriter pooledWriter;
+    qmlc.setPackagePool(pooledWriter.pool());
+    scriptc.setPackagePool(pooledWriter.pool());
+    QByteArray pooledUnit;
+    ret = qmlc.compile("qrc:/testqml/SubItemWithScript.qml", pooledUnit);
+    QVERIFY(ret);
+    ret = pooledWriter.addUnit(SUB_ITEM_WITH_SCRIPT_QMC, pooledUnit);
+    QVERIFY(ret);
+    ret = qmlc.compile("qrc:/testqml/SubItem.qml", tempDirPath(POOLED_PACKAGE_DIR "/" SUB_ITEM_QMC));
+    QVERIFY(ret);
+    ret = scriptc.compile("qrc:/testqml/testscript1.js", pooledUnit);
+    QVERIFY(ret);
+    ret = pooledWriter.addUnit(TEST_SCRIPT_1_JSC, pooledUnit);
+    QVERIFY(ret);
+    ret = scriptc.compile("qrc:/testqml/testscript2.js", pooledUnit);
+    QVERIFY(ret);
+    ret = pooledWriter.addUnit(TEST_SCRIPT_2_JSC, pooledUnit);
+    QVERIFY(ret);
+    ret = pooledWriter.write(tempDirPath(POOLED_PACKAGE_FILE));
+    QVERIFY(ret);
+    qmlc.setPackagePool(NULL);
+    scriptc.setPackagePool(NULL);
+
     // testmod 1
 
     ret = qmlc.compile("qrc:/testqml/testmod1.qml", tempDirPath(TEST_MOD_1_QMC));
@@ -189,6 +908,20 @@ void TestCreateFile::initTestCase()
     ret = QFile::copy(":/testqml/mod/qmldir", tempDirPath("mod/qmldir"));
     QVERIFY(ret);
 
+    // only the main type is precompiled
+    ret = dir.mkdir(MIXED_DIR);
+    QVERIFY(ret);
+    QFile mixedSub(tempDirPath(MIXED_SUB_QML));
+    QVERIFY(mixedSub.open(QFile::WriteOnly));
+    QVERIFY(mixedSub.write("import QtQuick 2.0\nItem {\n    width: 30\n}\n") > 0);
+    mixedSub.close();
+    QFile mixedMain(tempDirPath(MIXED_MAIN_QML));
+    QVERIFY(mixedMain.open(QFile::WriteOnly));
+    QVERIFY(mixedMain.write("import QtQuick 2.0\nItem {\n    width: sub.width\n    MixedSub {\n        id: sub\n    }\n}\n") > 0);
+    mixedMain.close();
+    ret = qmlc.compile(QUrl::fromLocalFile(tempDirPath(MIXED_MAIN_QML)).toString(), tempDirPath(MIXED_MAIN_QMC));
+    QVERIFY(ret);
+
     delete engine;
 }
 
@@ -35,9 +35,29 @@ private slots:
     void cleanupTestCase();
 
     void testLoadSingleFile();
+    void testLoadSingleFileWithoutMapping();
+    void testLoadAsync();
+    void testLoadCodeSection();
+    void testCompileToMemory();
+    void testLoadFromBuffer();
+    void testLoadFromResource();
+    void testLoadStaticUnit();
+    void testLoadCompressed();
+    void testLoadCorrupted();
+    void testOtherArchitecture();
+    void testLoadLargeUnit();
+    void testLoadCompactTables();
+    void testLoadPackage();
+    void testLoadPooledPackage();
     void testLoadDependency();
+    void testLoadDependencyList();
+    void testLoadTransitiveDependencies();
+    void testLoadSharedUnit();
+    void testLoadLazyLinking();
+    void testLoadSourceFallback();
     void testLoadModule1();
     void testLoadModule2();
+    void testModuleFingerprintMismatch();
 
 
 
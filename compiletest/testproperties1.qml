@@ -13,17 +13,23 @@
  * give you certain additional rights.  These rights are described in
  * the Digia Qt LGPL Exception version 1.1, included in the file
  * LGPL_EXCEPTION.txt in this package.
- *
- * Author: Mikko Hurskainen <mikko.hurskainen@nomovok.com>
  */
 
-#include "qmcbackedinstructionselection.h"
 
-QmcBackedInstructionSelection::QmcBackedInstructionSelection(QV4::JIT::CompilationUnit *compilationUnit)
-{
-    this->compilationUnit = compilationUnit;
-}
+import QtQuick 2.0
+
+Item {
+    id: root
+    property int count: 3
+    property var values: [1, 2]
+    property list<Item> items: [ Item { width: 5 }, Item { width: 7 } ]
+    property alias w: root.width
+    signal countUpdated(int value)
+    width: 100
+
+    function itemWidth(index) {
+        return items[index].width;
+    }
 
-QmcBackedInstructionSelection::~QmcBackedInstructionSelection()
-{
+    onCountChanged: countUpdated(count)
 }
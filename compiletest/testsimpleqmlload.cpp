@@ -336,6 +336,56 @@ void TestSimpleQmlLoad::loadAlias1()
     delete engine;
 }
 
+void TestSimpleQmlLoad::compileAndLoadProperties1()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    const QString TEST_FILE(":/testqml/testproperties1.qml");
+    QQmlComponent* component = compileAndLoad(engine, TEST_FILE);
+    QVERIFY(component);
+
+    QObject *myObject = component->create();
+    QVERIFY(myObject != NULL);
+    QVERIFY(myObject->property("count").toInt() == 3);
+    QVERIFY(myObject->property("values").toList().size() == 2);
+    QVERIFY(myObject->property("w").toInt() == 100);
+    QVariant ret;
+    QMetaObject::invokeMethod(myObject, "itemWidth", Q_RETURN_ARG(QVariant, ret), Q_ARG(QVariant, 1));
+    QVERIFY(ret.toInt() == 7);
+    QSignalSpy spy(myObject, SIGNAL(countUpdated(int)));
+    myObject->setProperty("count", QVariant(4));
+    QVERIFY(spy.count() == 1);
+    QVERIFY(spy.at(0).at(0).toInt() == 4);
+
+    delete myObject;
+    delete component;
+    delete engine;
+}
+
+void TestSimpleQmlLoad::loadProperties1()
+{
+    QQmlEngine *engine = new QQmlEngine;
+    const QString TEST_FILE(":/testqml/testproperties1.qml");
+    QQmlComponent* component = load(engine, TEST_FILE);
+    QVERIFY(component);
+
+    QObject *myObject = component->create();
+    QVERIFY(myObject != NULL);
+    QVERIFY(myObject->property("count").toInt() == 3);
+    QVERIFY(myObject->property("values").toList().size() == 2);
+    QVERIFY(myObject->property("w").toInt() == 100);
+    QVariant ret;
+    QMetaObject::invokeMethod(myObject, "itemWidth", Q_RETURN_ARG(QVariant, ret), Q_ARG(QVariant, 1));
+    QVERIFY(ret.toInt() == 7);
+    QSignalSpy spy(myObject, SIGNAL(countUpdated(int)));
+    myObject->setProperty("count", QVariant(4));
+    QVERIFY(spy.count() == 1);
+    QVERIFY(spy.at(0).at(0).toInt() == 4);
+
+    delete myObject;
+    delete component;
+    delete engine;
+}
+
 void TestSimpleQmlLoad::printErrors(const QList<QQmlError> &errors)
 {
     foreach (QQmlError error, errors)
@@ -62,6 +62,9 @@ private slots:
     void loadAlias1();
     void compileAndLoadAlias1();
 
+    void loadProperties1();
+    void compileAndLoadProperties1();
+
     void loadFunction1();
     void compileAndLoadFunction1();
 
@@ -0,0 +1,127 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#ifndef QMCCHECKSUM_H
+#define QMCCHECKSUM_H
+
+#include <QtGlobal>
+
+#include <string.h>
+
+// builtins of a target function need no intrinsics header or SSE4.2 build
+#if defined(Q_PROCESSOR_X86_64) && defined(Q_CC_GNU)
+#define QMC_CRC32C_SSE42
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define QMC_CRC32C_ARMV8
+#endif
+
+// CRC32C (Castagnoli) of unit sections, see QMC_UNIT_CHECKSUM_CRC32C,
+// uses the crc32 instructions of SSE4.2 when the cpu has them and of ARMv8
+// when the target has them, otherwise slicing-by-8 tables
+class QmcChecksum
+{
+public:
+    static quint32 crc32c(const char *data, qint64 size)
+    {
+        const uchar *p = reinterpret_cast<const uchar *>(data);
+#if defined(QMC_CRC32C_SSE42)
+        static const bool sse42 = __builtin_cpu_supports("sse4.2");
+        if (sse42)
+            return ~crc32cSse42(0xffffffff, p, size);
+        return ~crc32cSoftware(0xffffffff, p, size);
+#elif defined(QMC_CRC32C_ARMV8)
+        return ~crc32cArmv8(0xffffffff, p, size);
+#else
+        return ~crc32cSoftware(0xffffffff, p, size);
+#endif
+    }
+
+    static quint32 crc32cSoftware(quint32 crc, const uchar *p, qint64 size)
+    {
+        const quint32 (*table)[256] = tables();
+        for (; size >= 8; size -= 8, p += 8) {
+            const quint32 low = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (quint32(p[3]) << 24));
+            const quint32 high = p[4] | (p[5] << 8) | (p[6] << 16) | (quint32(p[7]) << 24);
+            crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff]
+                    ^ table[5][(low >> 16) & 0xff] ^ table[4][low >> 24]
+                    ^ table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff]
+                    ^ table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+        }
+        while (size--)
+            crc = table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        return crc;
+    }
+
+private:
+    // table[0] is the bytewise table, table[k] advances it by k zero bytes
+    struct Tables
+    {
+        Tables()
+        {
+            for (quint32 i = 0; i < 256; i++) {
+                quint32 crc = i;
+                for (int j = 0; j < 8; j++)
+                    crc = (crc >> 1) ^ (0x82f63b78 & (0 - (crc & 1)));
+                table[0][i] = crc;
+            }
+            for (int k = 1; k < 8; k++) {
+                for (int i = 0; i < 256; i++)
+                    table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+            }
+        }
+        quint32 table[8][256];
+    };
+
+    static const quint32 (*tables())[256]
+    {
+        static const Tables tables;
+        return tables.table;
+    }
+
+#if defined(QMC_CRC32C_SSE42)
+    __attribute__((target("sse4.2")))
+    static quint32 crc32cSse42(quint32 crc, const uchar *p, qint64 size)
+    {
+        unsigned long long crc64 = crc;
+        for (; size >= 8; size -= 8, p += 8) {
+            unsigned long long v;
+            memcpy(&v, p, sizeof (v));
+            crc64 = __builtin_ia32_crc32di(crc64, v);
+        }
+        crc = crc64;
+        while (size--)
+            crc = __builtin_ia32_crc32qi(crc, *p++);
+        return crc;
+    }
+#elif defined(QMC_CRC32C_ARMV8)
+    static quint32 crc32cArmv8(quint32 crc, const uchar *p, qint64 size)
+    {
+        for (; size >= 4; size -= 4, p += 4) {
+            quint32 v;
+            memcpy(&v, p, sizeof (v));
+            crc = __crc32cw(crc, v);
+        }
+        while (size--)
+            crc = __crc32cb(crc, *p++);
+        return crc;
+    }
+#endif
+};
+
+#endif // QMCCHECKSUM_H
@@ -0,0 +1,173 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#ifndef QMCCOMPRESSION_H
+#define QMCCOMPRESSION_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QVector>
+
+#include <string.h>
+
+// block compression of unit sections, the stream uses the LZ4 block format:
+// sequences of token, literals, 16-bit match offset and match length,
+// the last sequence has only literals
+class QmcCompression
+{
+public:
+    enum {
+        MinMatch = 4,
+        // last literals and distance of last match from end as in LZ4
+        LastLiterals = 5,
+        MatchLimit = 12,
+        MaxOffset = 0xffff,
+        HashBits = 12
+    };
+
+    // returns empty array if the data does not get smaller
+    static QByteArray compress(const char *data, qint64 size)
+    {
+        if (size <= MatchLimit || size > INT_MAX / 2)
+            return QByteArray();
+        const uchar *src = reinterpret_cast<const uchar *>(data);
+        QByteArray out;
+        out.reserve(size);
+        QVector<qint64> table(1 << HashBits, -1);
+
+        qint64 anchor = 0;
+        qint64 pos = 0;
+        const qint64 matchStartLimit = size - MatchLimit;
+        const qint64 matchEndLimit = size - LastLiterals;
+        while (pos < matchStartLimit) {
+            const quint32 sequence = read32(src + pos);
+            const quint32 hash = (sequence * 2654435761u) >> (32 - HashBits);
+            const qint64 ref = table[hash];
+            table[hash] = pos;
+            if (ref < 0 || pos - ref > MaxOffset || read32(src + ref) != sequence) {
+                pos++;
+                continue;
+            }
+            qint64 length = MinMatch;
+            while (pos + length < matchEndLimit && src[ref + length] == src[pos + length])
+                length++;
+
+            writeToken(out, pos - anchor, length - MinMatch);
+            out.append(reinterpret_cast<const char *>(src + anchor), pos - anchor);
+            out.append(char((pos - ref) & 0xff));
+            out.append(char((pos - ref) >> 8));
+            if (length - MinMatch >= 15)
+                writeLength(out, length - MinMatch - 15);
+            pos += length;
+            anchor = pos;
+            if (out.size() >= size)
+                return QByteArray();
+        }
+        writeToken(out, size - anchor, 0);
+        out.append(reinterpret_cast<const char *>(src + anchor), size - anchor);
+        if (out.size() >= size)
+            return QByteArray();
+        return out;
+    }
+
+    // decompresses exactly dstSize bytes, all reads and writes are bounds
+    // checked so corrupted data only makes this fail
+    static bool decompress(const char *data, qint64 size, char *dst, qint64 dstSize)
+    {
+        const uchar *ip = reinterpret_cast<const uchar *>(data);
+        const uchar *const ipEnd = ip + size;
+        uchar *op = reinterpret_cast<uchar *>(dst);
+        uchar *const opStart = op;
+        uchar *const opEnd = op + dstSize;
+        for (;;) {
+            if (ip >= ipEnd)
+                return false;
+            const uint token = *ip++;
+
+            qint64 literals = token >> 4;
+            if (literals == 15 && !readLength(&ip, ipEnd, &literals))
+                return false;
+            if (literals > ipEnd - ip || literals > opEnd - op)
+                return false;
+            memcpy(op, ip, literals);
+            ip += literals;
+            op += literals;
+            if (ip == ipEnd)
+                return op == opEnd;
+
+            if (ipEnd - ip < 2)
+                return false;
+            const qint64 offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > op - opStart)
+                return false;
+            qint64 length = token & 15;
+            if (length == 15 && !readLength(&ip, ipEnd, &length))
+                return false;
+            length += MinMatch;
+            if (length > opEnd - op)
+                return false;
+
+            // overlapping match repeats the last offset bytes
+            const uchar *match = op - offset;
+            if (offset >= length) {
+                memcpy(op, match, length);
+                op += length;
+            } else {
+                while (length--)
+                    *op++ = *match++;
+            }
+        }
+    }
+
+private:
+    static quint32 read32(const uchar *p)
+    {
+        quint32 v;
+        memcpy(&v, p, sizeof (v));
+        return v;
+    }
+
+    static void writeLength(QByteArray &out, qint64 length)
+    {
+        for (; length >= 255; length -= 255)
+            out.append(char(255));
+        out.append(char(length));
+    }
+
+    static void writeToken(QByteArray &out, qint64 literals, qint64 matchLength)
+    {
+        out.append(char((qMin<qint64>(literals, 15) << 4) | qMin<qint64>(matchLength, 15)));
+        if (literals >= 15)
+            writeLength(out, literals - 15);
+    }
+
+    static bool readLength(const uchar **ip, const uchar *ipEnd, qint64 *length)
+    {
+        uint b;
+        do {
+            if (*ip >= ipEnd)
+                return false;
+            b = *(*ip)++;
+            *length += b;
+        } while (b == 255);
+        return true;
+    }
+};
+
+#endif // QMCCOMPRESSION_H
@@ -25,64 +25,148 @@
 #include <QBitArray>
 #include <QByteArray>
 
+#include <string.h>
+
 #include <private/qv4compileddata_p.h>
 
 static const char QMC_UNIT_MAGIC_STR[] = "qmcunit1";
 
-#define QMC_UNIT_STRING_MAX_LEN 256
-
-#define QMC_UNIT_VERSION 1
-
-#define QMC_UNIT_NAME_MAX_LEN QMC_UNIT_STRING_MAX_LEN
-
-#define QMC_UNIT_URL_MAX_LEN QMC_UNIT_STRING_MAX_LEN
-
-#define QMC_UNIT_MAX_QML_UNIT_SIZE 8192
-
-#define QMC_UNIT_MAX_COMPILATION_UNIT_SIZE 8192
+#define QMC_UNIT_VERSION 4
 
-#define QMC_UNIT_MAX_IMPORTS 256
+// oldest version that can be loaded, version 1 has no section directory,
+// version 2 has no section flags, version 3 and older have no architecture
+#define QMC_UNIT_MIN_VERSION 1
 
-#define QMC_UNIT_MAX_STRINGS 256
+// there are no fixed limits on counts and sizes of unit data, the loader
+// only requires that everything fits inside the unit and sections
 
-#define QMC_UNIT_MAX_NAMESPACES 256
+// number of 32-bit words used to store a bit array of x bits
+#define QMC_UNIT_BIT_ARRAY_LENGTH(x) (((x) + 31) >> 5)
 
-#define QMC_UNIT_MAX_TYPE_REFERENCES 256
+// alignment of QmlUnit and compilation unit data inside the file
+#define QMC_UNIT_DATA_ALIGNMENT 8
 
-#define QMC_UNIT_MAX_CODE_REFS 256
-#define QMC_UNIT_MAX_CODE_REF_SIZE 8192
-
-#define QMC_UNIT_MAX_CODE_REF_LINK_CALLS 256
-
-#define QMC_UNIT_MAX_CONSTANT_VECTORS 256
-#define QMC_UNIT_MAX_CONSTANT_VECTOR_SIZE 256
+enum QmcFileType {
+    QMC_QML = 0,
+    QMC_JS
+};
 
-#define QMC_UNIT_MAX_OBJECT_INDEX_TO_ID_ROOT 256
+enum QmcUnitFlag {
+    // all data is naturally aligned relative to start of the unit, allows
+    // using the data in place from memory mapped file
+    QMC_UNIT_FLAG_ALIGNED = 0x1,
+    // code refs call runtime through a call table filled by the loader and
+    // address constants relative to code, code is loaded without patching
+    // (x86-64 only), layout of the code region is in qmcrelocation.h
+    QMC_UNIT_FLAG_PIC = 0x2,
+    // code refs are not stored inline, the whole code region is stored as
+    // page aligned section at the end of the unit so that it can be mapped
+    QMC_UNIT_FLAG_CODE_SECTION = 0x4,
+    // counts, lengths and index tables are stored as LEB128 varints and bit
+    // arrays as bytes, see qmcvarint.h (version 3)
+    QMC_UNIT_FLAG_COMPACT_TABLES = 0x8,
+    // constant tables of code refs and the strings of namespaces,
+    // dependencies and type resolutions are indexes to the pool of the
+    // package the unit is in, the unit cannot be loaded outside of it
+    QMC_UNIT_FLAG_SHARED_POOL = 0x10
+};
 
-#define QMC_UNIT_MAX_OBJECT_INDEX_TO_ID_COMPONENT 256
-#define QMC_UNIT_MAX_OBJECT_INDEX_TO_ID_COMPONENT_MAPPINGS 256
+// fields of compact tables stored as difference to the previous record,
+// bit n is field n of the record
+#define QMC_UNIT_COMPACT_DELTA_TYPE_REFERENCE 0x1 // index
+#define QMC_UNIT_COMPACT_DELTA_OBJECT_INDEX_TO_ID 0x1 // index
+#define QMC_UNIT_COMPACT_DELTA_ALIAS 0x1 // objectIndex
+#define QMC_UNIT_COMPACT_DELTA_LINK_CALL 0x2 // offset
+
+// alignment of the code section relative to start of the unit
+#define QMC_UNIT_CODE_SECTION_ALIGNMENT 4096
+
+// sections of the unit, version 1 files store them in this order without
+// directory, version 2 files list them in the section directory
+enum QmcUnitSectionId {
+    QMC_SECTION_NAMES = 1, // name and url
+    QMC_SECTION_QML_UNIT,
+    QMC_SECTION_UNIT,
+    QMC_SECTION_IMPORTS,
+    QMC_SECTION_STRINGS, // empty, strings are used from the string table of the unit
+    QMC_SECTION_NAMESPACES,
+    QMC_SECTION_TYPE_REFERENCES,
+    QMC_SECTION_CODE_REFS,
+    QMC_SECTION_OBJECT_INDEX_TO_ID_ROOT,
+    QMC_SECTION_OBJECT_INDEX_TO_ID_COMPONENT,
+    QMC_SECTION_ALIASES,
+    QMC_SECTION_CUSTOM_PARSERS,
+    QMC_SECTION_CUSTOM_PARSER_BINDINGS,
+    QMC_SECTION_DEFERRED_BINDINGS,
+    QMC_SECTION_CODE, // only with QMC_UNIT_FLAG_CODE_SECTION
+    QMC_SECTION_DEPENDENCIES, // files loaded with the unit, transitively, relative to it
+    QMC_SECTION_META_OBJECTS, // VME meta data computed by the compiler
+    QMC_SECTION_TYPE_RESOLUTIONS, // type references resolved by the compiler
+    QMC_SECTION_COUNT
+};
 
-#define QMC_UNIT_MAX_ALIASES 256
+enum QmcUnitSectionFlag {
+    // section data is quint64 uncompressed size followed by the section
+    // compressed as in qmccompression.h (version 3)
+    QMC_UNIT_SECTION_FLAG_COMPRESSED = 0x1
+};
 
-#define QMC_UNIT_MAX_CUSTOM_PARSERS 256
-#define QMC_UNIT_MAX_CUSTOM_PARSER_DATA_LENGTH 2048
-#define QMC_UNIT_MAX_CUSTOM_PARSER_BINDING_LENGTH 32
+// sections smaller than this are not worth compressing
+#define QMC_UNIT_SECTION_COMPRESSION_MIN_SIZE 64
 
-#define QMC_UNIT_MAX_CUSTOM_PARSER_BINDINGS 256
+// alignment of sections relative to start of the unit, uncompressed code
+// section uses QMC_UNIT_CODE_SECTION_ALIGNMENT
+#define QMC_UNIT_SECTION_ALIGNMENT 8
 
-#define QMC_UNIT_MAX_DEFERRED_BINDINGS 256
-#define QMC_UNIT_MAX_DEFERRED_BINDING_LENGTH 32
+inline int qmcUnitSectionAlignment(quint32 id, quint32 flags = 0)
+{
+    if (id == QMC_SECTION_CODE && !(flags & QMC_UNIT_SECTION_FLAG_COMPRESSED))
+        return QMC_UNIT_CODE_SECTION_ALIGNMENT;
+    return QMC_UNIT_SECTION_ALIGNMENT;
+}
 
-#define QMC_UNIT_BIT_ARRAY_LENGTH(x) (((x - 1) >> 5) + 1)
+enum QmcUnitChecksumType {
+    QMC_UNIT_CHECKSUM_NONE = 0,
+    // CRC32C of the section data as stored, see qmcchecksum.h
+    QMC_UNIT_CHECKSUM_CRC32C
+};
 
-enum QmcFileType {
-    QMC_QML = 0,
-    QMC_JS
+// architecture of the code in the unit, it is loaded only on the same one
+enum QmcArchitecture {
+    QMC_ARCH_NONE = 0, // version 3 and older
+    QMC_ARCH_X86 = 1,
+    QMC_ARCH_X86_64 = 2,
+    QMC_ARCH_ARMV7 = 3, // thumb-2
+    QMC_ARCH_ARM = 4, // traditional arm
+    QMC_ARCH_MIPS = 5
 };
 
+static const char * const QMC_ARCH_NAMES[] = { "none", "x86", "x86_64", "armv7", "arm", "mips" };
+
+inline const char *qmcArchitectureName(int architecture)
+{
+    if (architecture < 0 || architecture > QMC_ARCH_MIPS)
+        return "unknown";
+    return QMC_ARCH_NAMES[architecture];
+}
+
+// QMC_ARCH_NONE if name is not known
+inline QmcArchitecture qmcArchitectureFromName(const char *name)
+{
+    for (int i = QMC_ARCH_X86; i <= QMC_ARCH_MIPS; i++) {
+        if (!strcmp(name, QMC_ARCH_NAMES[i]))
+            return (QmcArchitecture)i;
+    }
+    return QMC_ARCH_NONE;
+}
+
 struct QmcUnitHeader {
     char magic[8];
-    quint32 type;
+    // type and flags share the space of former 32-bit type field, so
+    // unflagged units are identical to old ones and old loaders reject
+    // flagged units as unknown type
+    quint16 type;
+    quint16 flags;
     qint16 architecture;
     qint16 version;
     quint32 sizeQmlUnit;
@@ -138,9 +222,91 @@ struct QmcUnitDeferredBinding {
     QBitArray bindings;
 };
 
+enum QmcUnitTypeResolutionKind {
+    QMC_TYPE_RESOLUTION_NONE = 0, // resolved by name when loading
+    QMC_TYPE_RESOLUTION_TYPE, // registered type by qualified name
+    QMC_TYPE_RESOLUTION_COMPOSITE // unit relative to this one, without extension
+};
+
+// type reference as resolved by the compiler, valid while the fingerprint
+// of the imported modules matches, see QmcModuleFingerprint
+struct QmcUnitTypeResolution {
+    quint32 index; // as in QmcUnitTypeReference
+    quint32 kind;
+    qint32 majorVersion;
+    qint32 minorVersion;
+    QString name;
+};
+
+// VME meta data of an object and the layout of the base type property
+// cache it was built on, see QQmlPropertyCache
+struct QmcUnitMetaObject {
+    quint32 objectIndex;
+    quint32 propertyIndexCacheStart;
+    quint32 methodIndexCacheStart;
+    quint32 signalHandlerIndexCacheStart;
+    QByteArray data; // QQmlVMEMetaData
+};
+
+// link call index reserved for pointers to the constant table of the coderef,
+// offset is the location of the pointer as in JSC::DataLabelPtr
+#define QMC_LINK_INDEX_CONSTANT_TABLE 0xffffffff
+
+// follows the header in version 2, followed by the section entries
+struct QmcUnitSectionDirectory {
+    quint32 sections;
+    quint32 checksumType;
+};
+
+// version 2 had 32-bit id, flags are always zero there on little endian
+struct QmcUnitSection {
+    quint16 id;
+    quint16 flags;
+    quint32 checksum;
+    quint64 offset; // relative to start of unit
+    quint64 size;
+};
+
 struct QmcUnitCodeRefLinkCall {
-    quint32 index; // as in qmclinktable.h
+    quint32 index; // as in qmclinktable.h or QMC_LINK_INDEX_CONSTANT_TABLE
     quint32 offset; // inside coderef
 };
 
+// package of compiled units, units are looked up by their path relative to
+// the directory of the package so that a package can replace the files
+static const char QMC_PACKAGE_MAGIC_STR[] = "qmcpak01";
+
+#define QMC_PACKAGE_VERSION 2
+#define QMC_PACKAGE_MIN_VERSION 1 // version 1 has no pool
+
+// alignment of units relative to start of the package, keeps code sections
+// of the units page aligned in the file so that they can be mapped
+#define QMC_PACKAGE_UNIT_ALIGNMENT QMC_UNIT_CODE_SECTION_ALIGNMENT
+
+// followed by the pool header (version 2), the entries sorted by name,
+// then the names, the pool and the units
+struct QmcPackageHeader {
+    char magic[8];
+    quint32 version;
+    quint32 entries;
+};
+
+// strings and constants shared by the units of the package, strings are
+// quint32 offsets[strings + 1] relative to the end of the offsets followed
+// by the utf-8 data, constants are an aligned array of QV4::Primitive
+struct QmcPackagePoolHeader {
+    quint64 stringsOffset; // relative to start of package
+    quint64 constantsOffset; // relative to start of package
+    quint32 strings;
+    quint32 constants;
+};
+
+struct QmcPackageEntry {
+    quint64 nameOffset; // relative to start of package, utf-8 without terminator
+    quint32 nameLength;
+    quint32 reserved;
+    quint64 offset; // relative to start of package
+    quint64 size;
+};
+
 #endif // QMCFILE_H
@@ -0,0 +1,90 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#ifndef QMCMODULEFINGERPRINT_H
+#define QMCMODULEFINGERPRINT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QHash>
+
+#include <private/qqmlmetatype_p.h>
+
+#include "qmcchecksum.h"
+
+// fingerprint of the modules a unit imports, type references resolved by
+// the compiler stay valid while it does not change, the modules must be
+// imported already so that their types are registered. Types are covered
+// by name and version, a type registered again under the same name with
+// another class is not noticed
+class QmcModuleFingerprint
+{
+public:
+    QmcModuleFingerprint()
+        : data(qVersion())
+    {
+    }
+
+    void addImport(const QString &uri, int majorVersion)
+    {
+        data.append(importData(uri, majorVersion));
+    }
+
+    // data of importData, which the loader computes once per module
+    void addImportData(const QByteArray &importData)
+    {
+        data.append(importData);
+    }
+
+    // walks all registered types, use addImportData on hot paths
+    static QByteArray importData(const QString &uri, int majorVersion)
+    {
+        QQmlTypeModule *module = QQmlMetaType::typeModule(uri, majorVersion);
+        QByteArray data;
+        data.append(uri.toUtf8());
+        data.append(' ');
+        data.append(QByteArray::number(majorVersion));
+        data.append('.');
+        data.append(QByteArray::number(module ? module->maximumMinorVersion() : -1));
+        // types of the module in any order
+        int count = 0;
+        uint names = 0;
+        foreach (const QQmlType *type, QQmlMetaType::qmlTypes()) {
+            if (type->majorVersion() != majorVersion || type->module() != uri)
+                continue;
+            count++;
+            names += qHash(type->qmlTypeName()) ^ uint(type->minorVersion());
+        }
+        data.append(' ');
+        data.append(QByteArray::number(count));
+        data.append(' ');
+        data.append(QByteArray::number(names));
+        data.append(';');
+        return data;
+    }
+
+    quint32 value() const
+    {
+        return QmcChecksum::crc32c(data.constData(), data.size());
+    }
+
+private:
+    QByteArray data;
+};
+
+#endif // QMCMODULEFINGERPRINT_H
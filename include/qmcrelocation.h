@@ -0,0 +1,206 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+#ifndef QMCRELOCATION_H
+#define QMCRELOCATION_H
+
+#include <QtGlobal>
+#include <QVector>
+
+#include <private/qv4value_p.h>
+
+#include "MacroAssembler.h"
+
+#include "qmcfile.h"
+
+#include <string.h>
+
+// patches relocations of generated code directly, without an assembler
+// offsets are the ones recorded by the compiler: end of the call
+// instruction for calls and JSC::DataLabelPtr offset for pointers
+class QmcRelocation
+{
+public:
+    typedef JSC::MacroAssembler::AssemblerType_T AssemblerType;
+
+    static void linkCall(char *code, quint32 offset, void *function)
+    {
+#if CPU(X86_64)
+        // movabs r11, imm64; call r11
+        AssemblerType::linkPointer(code, JSC::AssemblerLabel(offset - REPTACH_OFFSET_CALL_R11), function);
+#else
+        AssemblerType::linkCall(code, JSC::AssemblerLabel(offset), function);
+#endif
+    }
+
+    static void linkPointer(char *code, quint32 offset, void *value)
+    {
+        AssemblerType::linkPointer(code, JSC::AssemblerLabel(offset), value);
+    }
+
+    // bytes patched before the offset, used for bounds checking
+    static quint32 callRelocationSize()
+    {
+#if CPU(X86_64)
+        return REPTACH_OFFSET_CALL_R11 + sizeof(void *);
+#elif CPU(ARM_THUMB2)
+        return 5 * sizeof(quint16);
+#else
+        return sizeof(qint32);
+#endif
+    }
+
+    static quint32 pointerRelocationSize()
+    {
+#if CPU(ARM_THUMB2)
+        return 4 * sizeof(quint16);
+#else
+        return sizeof(void *);
+#endif
+    }
+
+    // architecture of the code generated and linked by this build
+    static QmcArchitecture architecture()
+    {
+#if CPU(X86_64)
+        return QMC_ARCH_X86_64;
+#elif CPU(X86)
+        return QMC_ARCH_X86;
+#elif CPU(ARM_THUMB2)
+        return QMC_ARCH_ARMV7;
+#elif CPU(ARM_TRADITIONAL)
+        return QMC_ARCH_ARM;
+#elif CPU(MIPS)
+        return QMC_ARCH_MIPS;
+#else
+        return QMC_ARCH_NONE;
+#endif
+    }
+
+    static bool supportsPositionIndependentCode()
+    {
+#if CPU(X86_64)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // rewrites the call at offset to call through a pointer at target,
+    // target is relative to the same code, size of code does not change
+    static bool makeCallPositionIndependent(char *code, quint32 offset, qint64 target)
+    {
+#if CPU(X86_64)
+        // movabs r11, imm64; call r11 -> nop7; call [rip + disp32]
+        uchar *p = reinterpret_cast<uchar *>(code) + offset - 13;
+        if (offset < 13 || p[0] != 0x49 || p[1] != 0xbb || p[10] != 0x41 || p[11] != 0xff || p[12] != 0xd3)
+            return false;
+        const qint64 disp = target - offset;
+        if (disp != qint32(disp))
+            return false;
+        static const uchar nop7[] = { 0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00 };
+        memcpy(p, nop7, sizeof(nop7));
+        p[7] = 0xff;
+        p[8] = 0x15;
+        const qint32 disp32 = disp;
+        memcpy(p + 9, &disp32, sizeof(disp32));
+        return true;
+#else
+        Q_UNUSED(code);
+        Q_UNUSED(offset);
+        Q_UNUSED(target);
+        return false;
+#endif
+    }
+
+    // rewrites the pointer load at offset to compute address of target
+    static bool makePointerPositionIndependent(char *code, quint32 offset, qint64 target)
+    {
+#if CPU(X86_64)
+        // movabs reg, imm64 -> nop3; lea reg, [rip + disp32]
+        uchar *p = reinterpret_cast<uchar *>(code) + offset - 10;
+        if (offset < 10 || (p[0] & 0xfe) != 0x48 || (p[1] & 0xf8) != 0xb8)
+            return false;
+        const qint64 disp = target - offset;
+        if (disp != qint32(disp))
+            return false;
+        const int reg = (p[1] & 0x7) | ((p[0] & 0x1) << 3);
+        p[0] = 0x0f;
+        p[1] = 0x1f;
+        p[2] = 0x00;
+        p[3] = 0x48 | ((reg >> 3) << 2);
+        p[4] = 0x8d;
+        p[5] = 0x05 | ((reg & 0x7) << 3);
+        const qint32 disp32 = disp;
+        memcpy(p + 6, &disp32, sizeof(disp32));
+        return true;
+#else
+        Q_UNUSED(code);
+        Q_UNUSED(offset);
+        Q_UNUSED(target);
+        return false;
+#endif
+    }
+};
+
+// layout of the executable region of a unit, shared by the compiler and
+// the loader. Code refs come first, position independent units are
+// followed by their constant tables and the runtime call table.
+struct QmcCodeLayout
+{
+    enum { CodeRefAlignment = 16 };
+
+    QVector<quint32> codeRefOffsets;
+    QVector<quint32> constantTableOffsets;
+    quint32 callTableOffset;
+    qint64 size;
+
+    QmcCodeLayout(const QVector<quint32> &codeRefSizes, const QVector<quint32> &constantTableSizes,
+                  bool positionIndependent, int callTableSize)
+        : codeRefOffsets(codeRefSizes.size()),
+          constantTableOffsets(constantTableSizes.size()),
+          callTableOffset(0),
+          size(0)
+    {
+        for (int i = 0; i < codeRefSizes.size(); i++) {
+            if (codeRefSizes[i] == 0)
+                continue;
+            size = align(size, CodeRefAlignment);
+            codeRefOffsets[i] = size;
+            size += codeRefSizes[i];
+        }
+        if (!positionIndependent || size == 0)
+            return;
+        for (int i = 0; i < constantTableSizes.size(); i++) {
+            if (constantTableSizes[i] == 0)
+                continue;
+            size = align(size, Q_ALIGNOF(QV4::Primitive));
+            constantTableOffsets[i] = size;
+            size += qint64(constantTableSizes[i]) * sizeof(QV4::Primitive);
+        }
+        size = align(size, sizeof(void *));
+        callTableOffset = size;
+        size += qint64(callTableSize) * sizeof(void *);
+    }
+
+    static qint64 align(qint64 offset, int alignment)
+    {
+        return (offset + alignment - 1) & ~qint64(alignment - 1);
+    }
+};
+
+#endif // QMCRELOCATION_H
@@ -0,0 +1,131 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#ifndef QMCVARINT_H
+#define QMCVARINT_H
+
+#include <QtGlobal>
+#include <QtEndian>
+#include <QByteArray>
+
+// LEB128 varints for compact tables, see QMC_UNIT_FLAG_COMPACT_TABLES
+class QmcVarint
+{
+public:
+    enum { MaxLength = 5 };
+
+    static int encode(uchar *dst, quint32 v)
+    {
+        int n = 0;
+        for (; v >= 0x80; v >>= 7)
+            dst[n++] = uchar(v | 0x80);
+        dst[n++] = uchar(v);
+        return n;
+    }
+
+    static void append(QByteArray &out, quint32 v)
+    {
+        uchar buf[MaxLength];
+        out.append(reinterpret_cast<const char *>(buf), encode(buf, v));
+    }
+
+    // signed differences are stored zigzag encoded so small negative
+    // values stay short
+    static quint32 zigzag(qint32 v) { return (quint32(v) << 1) ^ quint32(v >> 31); }
+    static qint32 unzigzag(quint32 v) { return qint32(v >> 1) ^ -qint32(v & 1); }
+
+    // returns number of bytes used, 0 if truncated or over 32 bits
+    static int decode(const uchar *p, qint64 size, quint32 *v)
+    {
+        if (size >= 8) {
+            // whole value from one load, the first byte without the
+            // continuation bit ends it and the 7-bit groups are gathered
+            // with shifts and masks instead of a loop
+            const quint64 w = qFromLittleEndian<quint64>(p);
+            const quint64 stops = ~w & Q_UINT64_C(0x8080808080808080);
+            if (!stops)
+                return 0;
+            const int length = (countTrailingZeros(stops) >> 3) + 1;
+            if (length > MaxLength || (length == MaxLength && (p[4] & 0xf0)))
+                return 0;
+            const quint64 x = w & ((Q_UINT64_C(1) << (length * 8)) - 1);
+            *v = quint32((x & 0x7f) | ((x >> 1) & 0x3f80) | ((x >> 2) & 0x1fc000)
+                         | ((x >> 3) & 0xfe00000) | ((x >> 4) & Q_UINT64_C(0xf0000000)));
+            return length;
+        }
+        quint32 result = 0;
+        for (int i = 0; i < MaxLength && i < size; i++) {
+            if (i == MaxLength - 1 && (p[i] & 0xf0))
+                return 0;
+            result |= quint32(p[i] & 0x7f) << (7 * i);
+            if (!(p[i] & 0x80)) {
+                *v = result;
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    // table of count records of fields quint32 each, fields with their bit
+    // set in deltaMask are stored as difference to the previous record
+    static void appendTable(QByteArray &out, const quint32 *records, int count, int fields, quint32 deltaMask)
+    {
+        for (int i = 0; i < count; i++) {
+            for (int f = 0; f < fields; f++) {
+                quint32 v = records[i * fields + f];
+                if (deltaMask & (1u << f))
+                    v = zigzag(qint32(v - (i > 0 ? records[(i - 1) * fields + f] : 0)));
+                append(out, v);
+            }
+        }
+    }
+
+    // returns number of bytes used, -1 if data is not valid
+    static qint64 decodeTable(const uchar *p, qint64 size, quint32 *records, int count, int fields, quint32 deltaMask)
+    {
+        qint64 pos = 0;
+        for (int i = 0; i < count; i++) {
+            for (int f = 0; f < fields; f++) {
+                quint32 v;
+                const int n = decode(p + pos, size - pos, &v);
+                if (!n)
+                    return -1;
+                pos += n;
+                if (deltaMask & (1u << f))
+                    v = (i > 0 ? records[(i - 1) * fields + f] : 0) + quint32(unzigzag(v));
+                records[i * fields + f] = v;
+            }
+        }
+        return pos;
+    }
+
+private:
+    static int countTrailingZeros(quint64 v)
+    {
+#if defined(Q_CC_GNU)
+        return __builtin_ctzll(v);
+#else
+        int n = 0;
+        for (; !(v & 1); v >>= 1)
+            n++;
+        return n;
+#endif
+    }
+};
+
+#endif // QMCVARINT_H
@@ -20,37 +20,227 @@
 #include <QDataStream>
 #include <QTimer>
 #include <QQmlEngine>
+#include <QFileInfo>
+#include <QDir>
 
 #include <iostream>
 #include "qmlc.h"
 #include "scriptc.h"
 #include "comp.h"
+#include "qmcpackagewriter.h"
 
 using std::cerr;
 using std::endl;
 
+// packs compiled units, names are relative to the directory of the package
+static int pack(const QString &packageFile, const QStringList &files)
+{
+    QmcPackageWriter writer;
+    QDir dir(QFileInfo(packageFile).absolutePath());
+    bool ret = true;
+    foreach (const QString &file, files)
+        ret = ret && writer.addFile(dir.relativeFilePath(QFileInfo(file).absoluteFilePath()), file);
+    ret = ret && writer.write(packageFile);
+    foreach (QQmlError error, writer.errors())
+        cerr << "Error: " << error.toString().toStdString() << endl;
+    return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static Compiler *createCompiler(QQmlEngine *engine, const QString &file, const QStringList &options)
+{
+    Compiler *compiler = NULL;
+    if (file.endsWith(".js"))
+        compiler = new ScriptC(engine);
+    else if (file.endsWith(".qml"))
+        compiler = new QmlC(engine);
+    else {
+        cerr << "Supported filetypes include .js and .qml" << endl;
+        return NULL;
+    }
+    compiler->setPositionIndependentCode(options.contains("--pic"));
+    compiler->setCodeSection(options.contains("--code-section"));
+    compiler->setCompression(options.contains("--compress"));
+    compiler->setCompactTables(options.contains("--compact-tables"));
+    foreach (const QString &option, options) {
+        const QString target = option.startsWith("--target=") ? option.section('=', 1) : QString();
+        if (!target.isEmpty() && !compiler->setTargetArchitecture(target)) {
+            cerr << "Unknown target architecture " << target.toStdString() << endl;
+            delete compiler;
+            return NULL;
+        }
+    }
+    return compiler;
+}
+
+// name of the compiled file relative to dir, empty if the file is not
+// inside dir
+static QString unitName(const QDir &dir, const QString &file)
+{
+    QString name = dir.relativeFilePath(QFileInfo(file).absoluteFilePath());
+    if (name.startsWith("../") || QDir::isAbsolutePath(name)) {
+        cerr << "Error: " << file.toStdString() << " is not inside " << dir.path().toStdString() << endl;
+        return QString();
+    }
+    if (name.endsWith("qml"))
+        name[name.size() - 1] = 'c';
+    else
+        name.append("c");
+    return name;
+}
+
+// compiles the files into one package, constants and repeated strings are
+// stored once in the pool of the package
+static int bundle(const QString &packageFile, const QStringList &files, const QStringList &options)
+{
+    QQmlEngine engine;
+    QmcPackageWriter writer;
+    QDir dir(QFileInfo(packageFile).absolutePath());
+    bool ret = true;
+    foreach (const QString &file, files) {
+        const QString name = unitName(dir, file);
+        if (name.isEmpty())
+            return EXIT_FAILURE;
+        Compiler *compiler = createCompiler(&engine, file, options);
+        if (!compiler)
+            return EXIT_FAILURE;
+        compiler->setPackagePool(writer.pool());
+        QByteArray unit;
+        if (!compiler->compile("file:" + file, unit)) {
+            foreach (QQmlError error, compiler->errors())
+                cerr << "Error: " << error.toString().toStdString() << endl;
+            ret = false;
+        }
+        ret = ret && writer.addUnit(name, unit);
+        delete compiler;
+    }
+    ret = ret && writer.write(packageFile);
+    foreach (QQmlError error, writer.errors())
+        cerr << "Error: " << error.toString().toStdString() << endl;
+    return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// compiles the files into C++ source with the units as constant arrays,
+// the units are registered as resource paths relative to the output file
+// when the program starts, or when qmcInitUnits_<name>() is called
+static int emitCpp(const QString &outputFile, const QStringList &files, const QStringList &options)
+{
+    QQmlEngine engine;
+    QDir dir(QFileInfo(outputFile).absolutePath());
+    QString hook = QFileInfo(outputFile).completeBaseName();
+    for (int i = 0; i < hook.size(); i++) {
+        if (!hook.at(i).isLetterOrNumber() || hook.at(i).unicode() > 127)
+            hook[i] = '_';
+    }
+    hook.prepend("qmcInitUnits_");
+
+    QByteArray source;
+    source.append("// generated by qmc --emit-cpp, do not edit\n\n");
+    source.append("#include \"qmcloader.h\"\n");
+    QByteArray registration;
+    for (int i = 0; i < files.size(); i++) {
+        QByteArray name = unitName(dir, files.at(i)).toUtf8();
+        if (name.isEmpty())
+            return EXIT_FAILURE;
+        Compiler *compiler = createCompiler(&engine, files.at(i), options);
+        if (!compiler)
+            return EXIT_FAILURE;
+        QByteArray unit;
+        bool ret = compiler->compile("file:" + files.at(i), unit);
+        foreach (QQmlError error, compiler->errors())
+            cerr << "Error: " << error.toString().toStdString() << endl;
+        delete compiler;
+        if (!ret)
+            return EXIT_FAILURE;
+
+        // aligned like a mapped file so that the unit is used in place
+        source.append(QString("\nstatic const uchar qmc_unit_%1[%2] Q_DECL_ALIGN(16) = {")
+                      .arg(i).arg(qMax(unit.size(), 1)).toUtf8());
+        for (int j = 0; j < unit.size(); j++) {
+            source.append(j % 16 ? " " : "\n    ");
+            source.append(QByteArray::number((uchar)unit.at(j)));
+            source.append(",");
+        }
+        source.append("\n};\n");
+        name.replace("\\", "\\\\").replace("\"", "\\\"");
+        registration.append("    QmcLoader::registerStaticUnit(QStringLiteral(\":/" + name + "\"), ");
+        registration.append(QString("qmc_unit_%1, %2);\n").arg(i).arg(unit.size()).toUtf8());
+    }
+    source.append(QString("\nint %1()\n{\n").arg(hook).toUtf8());
+    source.append(registration);
+    source.append("    return 1;\n}\n\n");
+    source.append(QString("Q_CONSTRUCTOR_FUNCTION(%1)\n").arg(hook).toUtf8());
+
+    QFile output(outputFile);
+    if (!output.open(QFile::WriteOnly | QFile::Truncate) || output.write(source) != source.size()) {
+        cerr << "Error: cannot write " << outputFile.toStdString() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// options of the modes that compile, false if an option is unknown
+static bool readArgs(int argc, char *argv[], int first, QStringList &options, QStringList &files)
+{
+    QStringList known;
+    known << "--pic" << "--code-section" << "--compress" << "--compact-tables";
+    bool valid = true;
+    for (int i = first; i < argc; i++) {
+        const QString arg(argv[i]);
+        if (!arg.startsWith("--"))
+            files.append(arg);
+        else if (known.contains(arg) || arg.startsWith("--target="))
+            options.append(arg);
+        else
+            valid = false;
+    }
+    return valid;
+}
+
+static int usage(const char *name)
+{
+    cerr << "Usage: " << name << " [options] input-file" << endl;
+    cerr << "       " << name << " --pack output-file compiled-file..." << endl;
+    cerr << "       " << name << " --bundle output-file [options] input-file..." << endl;
+    cerr << "       " << name << " --emit-cpp output-file [options] input-file..." << endl;
+    cerr << "Options: [--pic] [--code-section] [--compress] [--compact-tables] [--target=arch]" << endl;
+    return EXIT_FAILURE;
+}
+
 int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
-    QQmlEngine *engine = new QQmlEngine;
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " input-file" << endl;
-        return EXIT_FAILURE;
+    if (argc > 1 && QString(argv[1]) == "--pack") {
+        if (argc < 4)
+            return usage(argv[0]);
+        QStringList files;
+        for (int i = 3; i < argc; i++)
+            files.append(argv[i]);
+        return pack(argv[2], files);
+    }
+    if (argc > 1 && (QString(argv[1]) == "--bundle" || QString(argv[1]) == "--emit-cpp")) {
+        QStringList files;
+        QStringList options;
+        if (argc < 3 || !readArgs(argc, argv, 3, options, files) || files.isEmpty())
+            return usage(argv[0]);
+        if (QString(argv[1]) == "--emit-cpp")
+            return emitCpp(argv[2], files, options);
+        return bundle(argv[2], files, options);
     }
-    QString fileName(argv[1]);
 
+    QStringList files;
+    QStringList options;
+    if (!readArgs(argc, argv, 1, options, files) || files.size() != 1)
+        return usage(argv[0]);
+    const QString fileName = files.first();
     if (fileName.lastIndexOf('.') <= 0) {
         cerr << "Filename cannot be empty";
         return EXIT_FAILURE;
     }
 
-    Compiler *compiler = NULL;
-    if (fileName.endsWith(".js")) {
-        compiler = new ScriptC(engine);
-    } else if (fileName.endsWith(".qml")) {
-        compiler = new QmlC(engine);
-    } else {
-        cerr << "Supported filetypes include .js and .qml" << endl;
+    QQmlEngine *engine = new QQmlEngine;
+    Compiler *compiler = createCompiler(engine, fileName, options);
+    if (!compiler) {
+        delete engine;
         return EXIT_FAILURE;
     }
     Comp comp;
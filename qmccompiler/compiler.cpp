@@ -22,6 +22,7 @@
 #include "compiler.h"
 #include "qmlcompilation.h"
 #include "qmcexporter.h"
+#include "qmcrelocation.h"
 
 class CompilerPrivate : QObjectPrivate
 {
@@ -36,11 +37,23 @@ public:
     QQmlEngine *engine;
     QString basePath;
     bool basePathSet;
+    bool positionIndependentCode;
+    bool codeSection;
+    bool compression;
+    bool compactTables;
+    QmcArchitecture targetArchitecture;
+    QmcPackagePoolWriter *packagePool;
 };
 
 CompilerPrivate::CompilerPrivate()
     : compilation(NULL),
-      basePathSet(false)
+      basePathSet(false),
+      positionIndependentCode(false),
+      codeSection(false),
+      compression(false),
+      compactTables(false),
+      targetArchitecture(QmcRelocation::architecture()),
+      packagePool(NULL)
 {
 }
 
@@ -87,6 +100,82 @@ void Compiler::setBasePath(const QString &path)
     d->basePath = path;
 }
 
+void Compiler::setPositionIndependentCode(bool enabled)
+{
+    Q_D(Compiler);
+    d->positionIndependentCode = enabled;
+}
+
+bool Compiler::isPositionIndependentCode() const
+{
+    const Q_D(Compiler);
+    return d->positionIndependentCode;
+}
+
+void Compiler::setCodeSection(bool enabled)
+{
+    Q_D(Compiler);
+    d->codeSection = enabled;
+}
+
+bool Compiler::isCodeSection() const
+{
+    const Q_D(Compiler);
+    return d->codeSection;
+}
+
+void Compiler::setCompression(bool enabled)
+{
+    Q_D(Compiler);
+    d->compression = enabled;
+}
+
+bool Compiler::isCompression() const
+{
+    const Q_D(Compiler);
+    return d->compression;
+}
+
+void Compiler::setCompactTables(bool enabled)
+{
+    Q_D(Compiler);
+    d->compactTables = enabled;
+}
+
+bool Compiler::isCompactTables() const
+{
+    const Q_D(Compiler);
+    return d->compactTables;
+}
+
+void Compiler::setPackagePool(QmcPackagePoolWriter *pool)
+{
+    Q_D(Compiler);
+    d->packagePool = pool;
+}
+
+QmcPackagePoolWriter *Compiler::packagePool() const
+{
+    const Q_D(Compiler);
+    return d->packagePool;
+}
+
+bool Compiler::setTargetArchitecture(const QString &name)
+{
+    Q_D(Compiler);
+    QmcArchitecture architecture = qmcArchitectureFromName(name.toLatin1().constData());
+    if (architecture == QMC_ARCH_NONE)
+        return false;
+    d->targetArchitecture = architecture;
+    return true;
+}
+
+QString Compiler::targetArchitecture() const
+{
+    const Q_D(Compiler);
+    return QString::fromLatin1(qmcArchitectureName(d->targetArchitecture));
+}
+
 bool Compiler::loadData()
 {
     Q_D(Compiler);
@@ -157,6 +246,15 @@ bool Compiler::compile(const QString &url)
         return false;
     }
 
+    if (d->targetArchitecture != QmcRelocation::architecture()) {
+        QQmlError error;
+        error.setDescription(QString("Cannot generate code for %1, JIT generates code for %2")
+                             .arg(qmcArchitectureName(d->targetArchitecture))
+                             .arg(qmcArchitectureName(QmcRelocation::architecture())));
+        appendError(error);
+        return false;
+    }
+
     Q_ASSERT(d->compilation == NULL);
     QmlCompilation* c = new QmlCompilation(url, QUrl(url), d->engine);
     d->compilation = c;
@@ -185,12 +283,28 @@ bool Compiler::compile(const QString &url)
 }
 
 bool Compiler::compile(const QString &url, QDataStream &output)
+{
+    QByteArray data;
+    if (!compile(url, data))
+        return false;
+    if (output.writeRawData(data.constData(), data.size()) != data.size()) {
+        QQmlError error;
+        error.setDescription("Could not write output");
+        appendError(error);
+        return false;
+    }
+    return true;
+}
+
+bool Compiler::compile(const QString &url, QByteArray &output)
 {
     Q_D(Compiler);
     bool ret = compile(url);
     if (ret) {
 
         ret = createExportStructures();
+        if (ret)
+            addScriptDependencies();
         if (d->basePathSet) {
             QString newUrl = d->basePath;
             int lastSlash = url.lastIndexOf('/');
@@ -215,27 +329,50 @@ bool Compiler::compile(const QString &url, QDataStream &output)
     return ret;
 }
 
+void Compiler::addScriptDependencies()
+{
+    Q_D(Compiler);
+    // imported scripts of qml and js units
+    QmlCompilation *c = d->compilation;
+    for (uint i = 0; i < c->qmlUnit->nImports; i++) {
+        const QV4::CompiledData::Import *import = c->qmlUnit->importAt(i);
+        if (import->type != QV4::CompiledData::Import::ImportScript)
+            continue;
+        const QString uri = c->unit->data->stringAt(import->uriIndex);
+        if (!c->dependencies.contains(uri))
+            c->dependencies.append(uri);
+    }
+}
+
 bool Compiler::compile(const QString &url, const QString &outputFile)
 {
-    // open output file
+    QByteArray data;
+    if (!compile(url, data))
+        return false;
+
+    // whole unit is written with one call
     QFile f(outputFile);
     if (!f.open(QFile::WriteOnly | QFile::Truncate)) {
         QQmlError error;
         error.setDescription("Could not open file for writing");
         error.setUrl(QUrl(outputFile));
+        appendError(error);
         return false;
     }
-    QDataStream out(&f);
-
-    bool ret = compile(url, out);
+    bool ret = f.write(data) == data.size();
     f.close();
-    if (!ret)
+    if (!ret) {
+        QQmlError error;
+        error.setDescription("Could not write file");
+        error.setUrl(QUrl(outputFile));
+        appendError(error);
         f.remove();
+    }
 
     return ret;
 }
 
-bool Compiler::exportData(QDataStream &output)
+bool Compiler::exportData(QByteArray &output)
 {
     Q_D(Compiler);
 
@@ -247,6 +384,11 @@ bool Compiler::exportData(QDataStream &output)
     }
 
     QmcExporter exporter(d->compilation);
+    exporter.setPositionIndependentCode(d->positionIndependentCode);
+    exporter.setCodeSection(d->codeSection);
+    exporter.setCompression(d->compression);
+    exporter.setCompactTables(d->compactTables);
+    exporter.setPackagePool(d->packagePool);
     bool ret = exporter.exportQmc(output);
     if (!ret) {
         QQmlError error;
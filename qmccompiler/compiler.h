@@ -24,11 +24,13 @@
 #include <QQmlError>
 #include <QList>
 #include <QDataStream>
+#include <QByteArray>
 #include <QUrl>
 
 class QmlCompilation;
 class CompilerPrivate;
 class QQmlEngine;
+class QmcPackagePoolWriter;
 
 namespace QV4 {
 namespace CompiledData {
@@ -61,8 +63,74 @@ public:
      */
     void unsetBasePath();
 
+    /**
+     * @brief setPositionIndependentCode
+     * Generates code that is loaded without patching, if supported
+     * by the target. Otherwise relocated code is generated.
+     * @param enabled
+     */
+    void setPositionIndependentCode(bool enabled);
+    bool isPositionIndependentCode() const;
+
+    /**
+     * @brief setCodeSection
+     * Stores the code in a page aligned section that the loader
+     * maps directly from the file.
+     * @param enabled
+     */
+    void setCodeSection(bool enabled);
+    bool isCodeSection() const;
+
+    /**
+     * @brief setCompression
+     * Compresses sections that get smaller. Compressed code section
+     * is decompressed to memory instead of mapped.
+     * @param enabled
+     */
+    void setCompression(bool enabled);
+    bool isCompression() const;
+
+    /**
+     * @brief setCompactTables
+     * Stores counts and index tables as varints, sorted tables as
+     * differences to the previous record.
+     * @param enabled
+     */
+    void setCompactTables(bool enabled);
+    bool isCompactTables() const;
+
+    /**
+     * @brief setTargetArchitecture
+     * Architecture the code is generated for, by name as in
+     * QMC_ARCH_NAMES. Code is generated by the JIT of the Qt build,
+     * so compiling fails unless the target is the one of the JIT.
+     * @param name
+     * @return false if the architecture is not known
+     */
+    bool setTargetArchitecture(const QString &name);
+    QString targetArchitecture() const;
+
+    /**
+     * @brief setPackagePool
+     * Stores constant tables and repeated strings in the pool shared by
+     * the units of a package instead of in each unit. The units can only
+     * be loaded from the package written with the pool.
+     * @param pool
+     * Pool of QmcPackageWriter, NULL to store everything in the unit
+     */
+    void setPackagePool(QmcPackagePoolWriter *pool);
+    QmcPackagePoolWriter *packagePool() const;
+
     bool compile(const QString &url, QDataStream &output);
     bool compile(const QString &url, const QString &outputFile);
+    /**
+     * @brief compile
+     * Compiles to memory, the output can be written or piped as is
+     * @param url
+     * @param output
+     * Compiled unit, replaces the contents
+     */
+    bool compile(const QString &url, QByteArray &output);
 
     QList<QQmlError> errors() const;
     bool isError() const;
@@ -82,7 +150,8 @@ protected:
     QQmlEngine *engine();
 
 private:
-    bool exportData(QDataStream &output);
+    bool exportData(QByteArray &output);
+    void addScriptDependencies();
     bool loadData();
     void clearError();
 
@@ -44,6 +44,7 @@ SOURCES += \
     componentandaliasresolver.cpp \
     irfunctioncleanser.cpp \
     qmcinstructionselection.cpp \
+    qmcpackagewriter.cpp \
     scriptc.cpp
 
 
@@ -66,6 +67,7 @@ HEADERS += qmccompiler_global.h \
     componentandaliasresolver.h \
     irfunctioncleanser.h \
     qmcinstructionselection.h \
+    qmcpackagewriter.h \
     scriptc.h
 
 
@@ -17,28 +17,151 @@
 
 #include "qmcexporter.h"
 #include "qmlcompilation.h"
+#include "qmclinktable.h"
+#include "qmcrelocation.h"
+#include "qmccompression.h"
+#include "qmcchecksum.h"
+#include "qmcvarint.h"
+#include "qmcpackagewriter.h"
 
 #include <private/qv4assembler_p.h>
 #include <private/qqmlcompiler_p.h>
 
+#include <limits.h>
+
 QmcExporter::QmcExporter(QmlCompilation *compilation, QObject *parent) :
     QObject(parent),
-    compilation(compilation)
+    compilation(compilation),
+    out(NULL),
+    sectionStart(0),
+    positionIndependent(false),
+    codeSection(false),
+    compression(false),
+    compactTables(false),
+    pool(NULL)
 {
 }
 
 bool QmcExporter::exportQmc(QDataStream &stream)
 {
-    return writeQmcUnit(compilation, stream);
+    QByteArray data;
+    if (!exportQmc(data))
+        return false;
+    return stream.writeRawData(data.constData(), data.size()) == data.size();
+}
+
+bool QmcExporter::exportQmc(QByteArray &data)
+{
+    out = &data;
+    bool ret = writeQmcUnit(compilation);
+    out = NULL;
+    return ret;
+}
+
+void QmcExporter::setPositionIndependentCode(bool positionIndependent)
+{
+    this->positionIndependent = positionIndependent;
+}
+
+void QmcExporter::setCodeSection(bool codeSection)
+{
+    this->codeSection = codeSection;
+}
+
+void QmcExporter::setCompression(bool compression)
+{
+    this->compression = compression;
+}
+
+void QmcExporter::setCompactTables(bool compactTables)
+{
+    this->compactTables = compactTables;
+}
+
+void QmcExporter::setPackagePool(QmcPackagePoolWriter *pool)
+{
+    this->pool = pool;
+}
+
+bool QmcExporter::writeCodeSection(QmlCompilation *c, const QList<QByteArray> &positionIndependentCode)
+{
+    // same layout as the loader uses for the executable region
+    QV4::JIT::CompilationUnit* compilationUnit = static_cast<QV4::JIT::CompilationUnit *>(c->unit);
+    const bool pic = !positionIndependentCode.isEmpty();
+    QVector<quint32> codeRefSizes;
+    QVector<quint32> constantTableSizes;
+    for (int i = 0; i < compilationUnit->codeRefs.size(); i++) {
+        codeRefSizes.append(compilationUnit->codeRefs[i].size());
+        constantTableSizes.append(compilationUnit->constantValues[i].size());
+    }
+    const quint32 linkTableSize = sizeof (QMC_LINK_TABLE) / sizeof (QmcLinkEntry);
+    const QmcCodeLayout layout(codeRefSizes, constantTableSizes, pic, linkTableSize);
+
+    // call table is filled by the loader, stored as zeros
+    const int start = out->size();
+    out->resize(start + layout.size);
+    char *section = out->data() + start;
+    memset(section, 0, layout.size);
+    for (int i = 0; i < compilationUnit->codeRefs.size(); i++) {
+        if (codeRefSizes[i] == 0)
+            continue;
+        const char *code = pic ? positionIndependentCode[i].constData()
+                               : (const char *)compilationUnit->codeRefs[i].code().executableAddress();
+        memcpy(section + layout.codeRefOffsets[i], code, codeRefSizes[i]);
+        if (pic && constantTableSizes[i] > 0)
+            memcpy(section + layout.constantTableOffsets[i], compilationUnit->constantValues[i].constData(),
+                   constantTableSizes[i] * sizeof(QV4::Primitive));
+    }
+    return true;
+}
+
+bool QmcExporter::createPositionIndependentCode(QmlCompilation *c, QList<QByteArray> &code)
+{
+    if (!QmcRelocation::supportsPositionIndependentCode())
+        return false;
+
+    QV4::JIT::CompilationUnit* compilationUnit = static_cast<QV4::JIT::CompilationUnit *>(c->unit);
+    QVector<quint32> codeRefSizes;
+    QVector<quint32> constantTableSizes;
+    for (int i = 0; i < compilationUnit->codeRefs.size(); i++) {
+        codeRefSizes.append(compilationUnit->codeRefs[i].size());
+        constantTableSizes.append(compilationUnit->constantValues[i].size());
+    }
+    const quint32 linkTableSize = sizeof (QMC_LINK_TABLE) / sizeof (QmcLinkEntry);
+    const QmcCodeLayout layout(codeRefSizes, constantTableSizes, true, linkTableSize);
+
+    // targets are relative to start of each code ref
+    for (int i = 0; i < compilationUnit->codeRefs.size(); i++) {
+        const JSC::MacroAssemblerCodeRef &codeRef = compilationUnit->codeRefs[i];
+        QByteArray bytes((const char *)codeRef.code().executableAddress(), codeRef.size());
+        const qint64 base = layout.codeRefOffsets[i];
+        foreach (const QmcUnitCodeRefLinkCall &link, c->linkData[i]) {
+            bool ok;
+            if (link.index == QMC_LINK_INDEX_CONSTANT_TABLE)
+                ok = QmcRelocation::makePointerPositionIndependent(bytes.data(), link.offset, layout.constantTableOffsets[i] - base);
+            else
+                ok = QmcRelocation::makeCallPositionIndependent(bytes.data(), link.offset,
+                                                                layout.callTableOffset + qint64(link.index) * sizeof(void *) - base);
+            if (!ok)
+                return false;
+        }
+        code.append(bytes);
+    }
+    return true;
 }
 
 void QmcExporter::createHeader(QmcUnitHeader &header, QmlCompilation *c)
 {
     memset(&header, 0, sizeof(QmcUnitHeader));
     strcpy(header.magic, QMC_UNIT_MAGIC_STR);
-    header.architecture = 0;
+    header.architecture = QmcRelocation::architecture();
     header.version = QMC_UNIT_VERSION;
-    header.type = (quint32)c->type;
+    header.type = (quint16)c->type;
+    header.flags = QMC_UNIT_FLAG_ALIGNED;
+    if (compactTables)
+        header.flags |= QMC_UNIT_FLAG_COMPACT_TABLES;
+    if (pool)
+        header.flags |= QMC_UNIT_FLAG_SHARED_POOL;
     header.sizeQmlUnit = c->qmlUnit->qmlUnitSize;
     header.sizeUnit = c->unit->data->unitSize;
     header.imports = c->qmlUnit->nImports;
@@ -55,199 +178,399 @@ void QmcExporter::createHeader(QmcUnitHeader &header, QmlCompilation *c)
     header.deferredBindings = c->deferredBindings.size();
 }
 
-bool QmcExporter::writeBitArray(QDataStream &stream, const QBitArray &array)
+bool QmcExporter::writeBitArray(const QBitArray &array)
 {
     quint32 lenBits = array.size();
-    quint32 len = QMC_UNIT_BIT_ARRAY_LENGTH(array.size());
-    if (!writeData(stream, (const char *)&lenBits, sizeof(quint32)))
+    if (!writeCount(lenBits))
         return false;
-    if (array.size() == 0)
-        return true;
-    quint32* buf = new quint32[len];
-    quint32* p = buf;
-    for (int i = 0; i < array.size(); i++) {
-        if (i % 32 == 0) {
-            *p = 0;
-            if (i > 0)
-                p++;
+    if (compactTables) {
+        // bit i is bit i % 8 of byte i / 8
+        QByteArray bytes((lenBits + 7) / 8, '\0');
+        for (quint32 i = 0; i < lenBits; i++) {
+            if (array.testBit(i))
+                bytes[i / 8] = bytes.at(i / 8) | (1 << (i % 8));
         }
-        if (array.at(i)) {
-            if (i % 32 == 0)
-                *p = 1;
-            else
-                *p = ( (*p) | (1 << (i % 32)));
+        return writeData(bytes.constData(), bytes.size());
+    }
+    // bit i is bit i % 32 of word i / 32
+    const quint32 len = QMC_UNIT_BIT_ARRAY_LENGTH(lenBits);
+    for (quint32 w = 0; w < len; w++) {
+        quint32 word = 0;
+        for (quint32 i = w * 32; i < lenBits && i < (w + 1) * 32; i++) {
+            if (array.testBit(i))
+                word |= 1u << (i % 32);
         }
+        if (!writeData((const char *)&word, sizeof(quint32), sizeof(quint32)))
+            return false;
     }
-    if (!writeData(stream, (const char *)buf, sizeof (quint32) * len))
-        return false;
     return true;
 }
 
-bool QmcExporter::writeString(QDataStream &stream, QString string)
+bool QmcExporter::writeString(const QString &string)
 {
-    quint32 len = string.length();
-    int ret = stream.writeRawData((const char*)&len, sizeof(len));
-    if (ret != sizeof(len))
+    // encoded straight to the output, length is utf-8 bytes and is
+    // filled in after encoding
+    quint32 len = 0;
+    if (!writeData((const char*)&len, sizeof(len), sizeof(len)))
         return false;
-
-    if (len == 0)
+    const int lenPos = out->size() - sizeof(len);
+    if (string.isEmpty())
         return true;
 
-    ret = stream.writeRawData(string.toUtf8().data(), string.length());
-    if (ret != string.length())
-        return false;
+    // utf-8 takes at most 3 bytes per utf-16 code unit
+    const int start = out->size();
+    out->resize(start + string.size() * 3);
+    uchar *begin = (uchar *)out->data() + start;
+    uchar *dst = begin;
+    const ushort *src = string.utf16();
+    const int size = string.size();
+    for (int i = 0; i < size; i++) {
+        uint ch = src[i];
+        if (ch < 0x80) {
+            *dst++ = ch;
+        } else if (ch < 0x800) {
+            *dst++ = 0xc0 | (ch >> 6);
+            *dst++ = 0x80 | (ch & 0x3f);
+        } else if (QChar::isHighSurrogate(ch) && i + 1 < size && QChar::isLowSurrogate(src[i + 1])) {
+            ch = QChar::surrogateToUcs4(ch, src[++i]);
+            *dst++ = 0xf0 | (ch >> 18);
+            *dst++ = 0x80 | ((ch >> 12) & 0x3f);
+            *dst++ = 0x80 | ((ch >> 6) & 0x3f);
+            *dst++ = 0x80 | (ch & 0x3f);
+        } else {
+            if (QChar::isSurrogate(ch))
+                ch = QChar::ReplacementCharacter;
+            *dst++ = 0xe0 | (ch >> 12);
+            *dst++ = 0x80 | ((ch >> 6) & 0x3f);
+            *dst++ = 0x80 | (ch & 0x3f);
+        }
+    }
+    len = dst - begin;
+    out->resize(start + len);
+    memcpy(out->data() + lenPos, &len, sizeof(len));
     return true;
 }
 
-bool QmcExporter::writeData(QDataStream& stream, const char* data, int len)
+bool QmcExporter::writeSharedString(const QString &string)
 {
-    if (stream.writeRawData(data, len) != len)
+    // strings repeated in many units of a package are stored once
+    if (pool)
+        return writeCount(pool->addString(string));
+    return writeString(string);
+}
+
+bool QmcExporter::writeData(const char* data, qint64 len, int alignment)
+{
+    // pad to alignment relative to start of the section or unit being
+    // written, see QMC_UNIT_FLAG_ALIGNED
+    const qint64 written = out->size() - sectionStart;
+    const int padLen = (alignment - (written % alignment)) % alignment;
+    if (qint64(out->size()) + padLen + len > INT_MAX)
         return false;
-    else
+    if (padLen > 0) {
+        const int start = out->size();
+        out->resize(start + padLen);
+        memset(out->data() + start, 0, padLen);
+    }
+    out->append(data, len);
+    return true;
+}
+
+bool QmcExporter::writeCount(quint32 count)
+{
+    if (compactTables) {
+        QmcVarint::append(*out, count);
+        return true;
+    }
+    return writeData((const char *)&count, sizeof(quint32), sizeof(quint32));
+}
+
+bool QmcExporter::writeTable(const void *records, int count, int recordSize, int alignment, quint32 deltaMask)
+{
+    if (count == 0)
         return true;
+    if (compactTables) {
+        QmcVarint::appendTable(*out, (const quint32 *)records, count, recordSize / sizeof(quint32), deltaMask);
+        return true;
+    }
+    return writeData((const char *)records, qint64(count) * recordSize, alignment);
 }
 
-bool QmcExporter::writeDataWithLen(QDataStream& stream, const char* data, int len)
+bool QmcExporter::writeDataWithLen(const char* data, qint64 len)
 {
-    quint32 l = len;
-    if (!writeData(stream, (const char *)&l, sizeof(quint32)))
+    if (!writeCount(len))
         return false;
-    if (!writeData(stream, data, len))
+    if (!writeData(data, len))
         return false;
     return true;
 }
 
-bool QmcExporter::writeQmcUnit(QmlCompilation *c, QDataStream &stream)
+bool QmcExporter::writeQmcUnit(QmlCompilation *c)
 {
     QmcUnitHeader header;
     createHeader(header, c);
 
-    if (!writeData(stream, (const char*)&header, sizeof (QmcUnitHeader)))
-        return false;
+    // falls back to relocated code if the code cannot be converted
+    QList<QByteArray> positionIndependentCode;
+    if (positionIndependent && createPositionIndependentCode(c, positionIndependentCode))
+        header.flags |= QMC_UNIT_FLAG_PIC;
+    else
+        positionIndependentCode.clear();
+    if (codeSection)
+        header.flags |= QMC_UNIT_FLAG_CODE_SECTION;
 
-    if (!writeString(stream, c->name))
-        return false;
+    // every section is listed, even if empty, so the directory has fixed
+    // size and the sections can be written after it in one pass
+    QVector<QmcUnitSection> sections;
+    for (int id = QMC_SECTION_NAMES; id < QMC_SECTION_COUNT; id++) {
+        if (id == QMC_SECTION_CODE && !(header.flags & QMC_UNIT_FLAG_CODE_SECTION))
+            continue;
+        QmcUnitSection section;
+        memset(&section, 0, sizeof(section));
+        section.id = id;
+        sections.append(section);
+    }
 
-    if (!writeString(stream, c->urlString))
-        return false;
+    QmcUnitSectionDirectory directory;
+    directory.sections = sections.size();
+    directory.checksumType = QMC_UNIT_CHECKSUM_CRC32C;
 
-    QV4::CompiledData::QmlUnit *qmlUnit = c->qmlUnit;
-    if (!writeData(stream, (const char*)qmlUnit, qmlUnit->qmlUnitSize))
-        return false;
-    QV4::CompiledData::Unit *unit = c->unit->data;
-    if (!writeData(stream, (const char*)unit, unit->unitSize))
+    const qint64 directoryOffset = QmcCodeLayout::align(sizeof(QmcUnitHeader), Q_ALIGNOF(QmcUnitSectionDirectory));
+    const qint64 sectionsOffset = QmcCodeLayout::align(directoryOffset + sizeof(QmcUnitSectionDirectory), Q_ALIGNOF(QmcUnitSection));
+    const qint64 dataOffset = sectionsOffset + sections.size() * sizeof(QmcUnitSection);
+
+    // the whole unit is written to one buffer of its maximum size
+    const qint64 size = c->calculateSize(codeSection);
+    if (size < 0)
         return false;
+    const qint64 reserved = qMin<qint64>(INT_MAX, dataOffset + size + sections.size() * QMC_UNIT_SECTION_ALIGNMENT
+                                         + (codeSection ? QMC_UNIT_CODE_SECTION_ALIGNMENT : 0));
+    out->clear();
+    out->reserve(reserved);
+    out->fill('\0', dataOffset);
 
-#if 0
-    for (uint i = 0; i < qmlUnit->nObjects; i++) {
-        const QV4::CompiledData::Object *obj = qmlUnit->objectAt(i);
-        qDebug() << "object" << i << "inh" << obj->inheritedTypeNameIndex << "/" << c->unit->data->stringAt(obj->inheritedTypeNameIndex);
-        for (uint j = 0; j < obj->nBindings; j++) {
-            const QV4::CompiledData::Binding *b = &obj->bindingTable()[j];
-            qDebug() << "-> binding" << j << "type" << b->type << "recurse" << bool(b->type >= QV4::CompiledData::Binding::Type_Object) << "target" << b->value.objectIndex;
+    for (int i = 0; i < sections.size(); i++) {
+        QmcUnitSection &section = sections[i];
+        const qint64 previousEnd = out->size();
+        sectionStart = 0;
+        if (!writeData(NULL, 0, qmcUnitSectionAlignment(section.id)))
+            return false;
+        sectionStart = out->size();
+        if (!writeSection(c, header, section.id, positionIndependentCode))
+            return false;
+        qint64 sectionSize = out->size() - sectionStart;
+
+        // compressed data replaces the section, incompressible sections are
+        // stored as is
+        if (compression && sectionSize >= QMC_UNIT_SECTION_COMPRESSION_MIN_SIZE) {
+            QByteArray compressed = QmcCompression::compress(out->constData() + sectionStart, sectionSize);
+            if (!compressed.isEmpty() && compressed.size() + sizeof (quint64) < quint64(sectionSize)) {
+                quint64 uncompressedSize = sectionSize;
+                section.flags |= QMC_UNIT_SECTION_FLAG_COMPRESSED;
+                out->resize(previousEnd);
+                sectionStart = 0;
+                if (!writeData(NULL, 0, qmcUnitSectionAlignment(section.id, section.flags)))
+                    return false;
+                sectionStart = out->size();
+                out->append((const char *)&uncompressedSize, sizeof (uncompressedSize));
+                out->append(compressed);
+                sectionSize = out->size() - sectionStart;
+            }
         }
+        section.offset = sectionStart;
+        section.size = sectionSize;
+        section.checksum = QmcChecksum::crc32c(out->constData() + sectionStart, sectionSize);
     }
-#endif
 
-    // imports
-    for (uint i = 0; i < c->qmlUnit->nImports; i++) {
-        const QV4::CompiledData::Import *import = c->qmlUnit->importAt(i);
-        if (!writeData(stream, (const char*)import, sizeof(QV4::CompiledData::Import)))
-            return false;
-    }
+    Q_ASSERT(out->size() <= reserved);
+    memcpy(out->data(), &header, sizeof(QmcUnitHeader));
+    memcpy(out->data() + directoryOffset, &directory, sizeof(QmcUnitSectionDirectory));
+    memcpy(out->data() + sectionsOffset, sections.constData(), sections.size() * sizeof(QmcUnitSection));
+    return true;
+}
 
-    // strings
-    for (uint i = 0; i < header.strings; i++) {
-        if (!writeString(stream, c->unit->data->stringAt(i)))
+bool QmcExporter::writeSection(QmlCompilation *c, const QmcUnitHeader &header, int id,
+                               const QList<QByteArray> &positionIndependentCode)
+{
+    QV4::JIT::CompilationUnit* compilationUnit = static_cast<QV4::JIT::CompilationUnit *>(c->unit);
+    switch (id) {
+    case QMC_SECTION_NAMES: {
+        if (!writeString(c->name))
             return false;
-    }
 
-    // namespaces
-    foreach (const QString &ns, c->namespaces) {
-        if (!writeString(stream, ns))
+        if (!writeString(c->urlString))
             return false;
+        break;
     }
-
-    // type references
-    foreach (const QmcUnitTypeReference &typeRef, c->exportTypeRefs) {
-        if (!writeData(stream, (const char *)&typeRef, sizeof (QmcUnitTypeReference)))
+    case QMC_SECTION_QML_UNIT: {
+        QV4::CompiledData::QmlUnit *qmlUnit = c->qmlUnit;
+        if (!writeData((const char*)qmlUnit, qmlUnit->qmlUnitSize, QMC_UNIT_DATA_ALIGNMENT))
             return false;
+        break;
     }
-
-    // codeRefs
-    QV4::JIT::CompilationUnit* compilationUnit = static_cast<QV4::JIT::CompilationUnit *>(c->unit);
-    for (int i = 0; i < compilationUnit->codeRefs.size(); i++) {
-        const JSC::MacroAssemblerCodeRef &codeRef = compilationUnit->codeRefs[i];
-        const QVector<QmcUnitCodeRefLinkCall> &linkCalls = c->linkData[i];
-        const QVector<QV4::Primitive> &constantValue = compilationUnit->constantValues[i];
-        if (!writeDataWithLen(stream, (const char *)codeRef.code().executableAddress(), codeRef.size()))
+    case QMC_SECTION_UNIT: {
+        // loader uses the unit in place, so it must not be freed by the compilation unit
+        QV4::CompiledData::Unit *unit = c->unit->data;
+        QV4::CompiledData::Unit unitHeader = *unit;
+        unitHeader.flags |= QV4::CompiledData::Unit::StaticData;
+        if (!writeData((const char*)&unitHeader, sizeof(QV4::CompiledData::Unit), QMC_UNIT_DATA_ALIGNMENT))
             return false;
-        quint32 linkCallCount = linkCalls.size();
-        if (!writeData(stream, (const char *)&linkCallCount, sizeof(quint32)))
+        if (!writeData((const char*)unit + sizeof(QV4::CompiledData::Unit), unit->unitSize - sizeof(QV4::CompiledData::Unit)))
             return false;
-        if (linkCallCount > 0) {
-            if (!writeData(stream, (const char *)linkCalls.data(), linkCalls.size() * sizeof (QmcUnitCodeRefLinkCall)))
+        break;
+    }
+    case QMC_SECTION_IMPORTS: {
+        for (uint i = 0; i < c->qmlUnit->nImports; i++) {
+            const QV4::CompiledData::Import *import = c->qmlUnit->importAt(i);
+            if (!writeData((const char*)import, sizeof(QV4::CompiledData::Import), Q_ALIGNOF(QV4::CompiledData::Import)))
                 return false;
         }
-        quint32 constTableCount = constantValue.size();
-        if (!writeData(stream, (const char *)&constTableCount, sizeof(quint32)))
-            return false;
-        if (constTableCount > 0) {
-            if (!writeData(stream, (const char*)constantValue.data(), sizeof(QV4::Primitive) * constantValue.size()))
+        break;
+    }
+    case QMC_SECTION_STRINGS:
+        // the loader uses the utf-16 string table of the unit in place
+        break;
+    case QMC_SECTION_NAMESPACES: {
+        foreach (const QString &ns, c->namespaces) {
+            if (!writeSharedString(ns))
                 return false;
         }
+        break;
     }
-
-    // object index -> id
-    foreach (const QmcUnitObjectIndexToId &mapping, c->objectIndexToIdRoot) {
-        if (!writeData(stream, (const char *)&mapping, sizeof (QmcUnitObjectIndexToId)))
+    case QMC_SECTION_TYPE_REFERENCES: {
+        QVector<QmcUnitTypeReference> typeRefs = QVector<QmcUnitTypeReference>::fromList(c->exportTypeRefs);
+        if (!writeTable(typeRefs.constData(), typeRefs.size(), sizeof(QmcUnitTypeReference),
+                        Q_ALIGNOF(QmcUnitTypeReference), QMC_UNIT_COMPACT_DELTA_TYPE_REFERENCE))
             return false;
+        break;
     }
-
-    // component index + object index -> id
-    foreach (const QmcUnitObjectIndexToIdComponent &mapping, c->objectIndexToIdComponent) {
-        if (!writeData(stream, (const char *)&mapping.componentIndex, sizeof (quint32)))
-            return false;
-        quint32 len = mapping.mappings.size();
-        if (!writeData(stream, (const char *)&len, sizeof (quint32)))
-            return false;
-        if (mapping.mappings.size() == 0)
-            continue;
-        if (!writeData(stream, (const char *)mapping.mappings.data(), mapping.mappings.size() * sizeof (QmcUnitObjectIndexToId)))
-            return false;
+    case QMC_SECTION_CODE_REFS: {
+        for (int i = 0; i < compilationUnit->codeRefs.size(); i++) {
+            const JSC::MacroAssemblerCodeRef &codeRef = compilationUnit->codeRefs[i];
+            const QVector<QmcUnitCodeRefLinkCall> &linkCalls = c->linkData[i];
+            const QVector<QV4::Primitive> &constantValue = compilationUnit->constantValues[i];
+            if (header.flags & QMC_UNIT_FLAG_CODE_SECTION) {
+                if (!writeCount(codeRef.size()))
+                    return false;
+            } else if (header.flags & QMC_UNIT_FLAG_PIC) {
+                const QByteArray &code = positionIndependentCode[i];
+                if (!writeDataWithLen(code.constData(), code.size()))
+                    return false;
+            } else if (!writeDataWithLen((const char *)codeRef.code().executableAddress(), codeRef.size()))
+                return false;
+            if (!writeCount(linkCalls.size()))
+                return false;
+            if (!writeTable(linkCalls.constData(), linkCalls.size(), sizeof(QmcUnitCodeRefLinkCall),
+                            Q_ALIGNOF(QmcUnitCodeRefLinkCall), QMC_UNIT_COMPACT_DELTA_LINK_CALL))
+                return false;
+            quint32 constTableCount = constantValue.size();
+            if (!writeCount(constTableCount))
+                return false;
+            if (constTableCount > 0 && pool) {
+                if (!writeCount(pool->addConstants(constantValue.constData(), constantValue.size())))
+                    return false;
+            } else if (constTableCount > 0) {
+                if (!writeData((const char*)constantValue.data(), sizeof(QV4::Primitive) * constantValue.size(), Q_ALIGNOF(QV4::Primitive)))
+                    return false;
+            }
+        }
+        break;
     }
-
-    // aliases
-    foreach (const QmcUnitAlias &alias, c->aliases) {
-        if (!writeData(stream, (const char *)&alias, sizeof (QmcUnitAlias)))
+    case QMC_SECTION_OBJECT_INDEX_TO_ID_ROOT: {
+        QVector<QmcUnitObjectIndexToId> mappings = QVector<QmcUnitObjectIndexToId>::fromList(c->objectIndexToIdRoot);
+        if (!writeTable(mappings.constData(), mappings.size(), sizeof(QmcUnitObjectIndexToId),
+                        Q_ALIGNOF(QmcUnitObjectIndexToId), QMC_UNIT_COMPACT_DELTA_OBJECT_INDEX_TO_ID))
             return false;
+        break;
     }
-
-    // custom parsers
-    foreach (const QmcUnitCustomParser &customParser, c->customParsers) {
-        if (!writeData(stream, (const char *)&customParser.objectIndex, sizeof(quint32)))
+    case QMC_SECTION_OBJECT_INDEX_TO_ID_COMPONENT: {
+        foreach (const QmcUnitObjectIndexToIdComponent &mapping, c->objectIndexToIdComponent) {
+            if (!writeCount(mapping.componentIndex))
+                return false;
+            if (!writeCount(mapping.mappings.size()))
+                return false;
+            if (!writeTable(mapping.mappings.constData(), mapping.mappings.size(), sizeof(QmcUnitObjectIndexToId),
+                            Q_ALIGNOF(QmcUnitObjectIndexToId), QMC_UNIT_COMPACT_DELTA_OBJECT_INDEX_TO_ID))
+                return false;
+        }
+        break;
+    }
+    case QMC_SECTION_ALIASES: {
+        QVector<QmcUnitAlias> aliases = QVector<QmcUnitAlias>::fromList(c->aliases);
+        if (!writeTable(aliases.constData(), aliases.size(), sizeof(QmcUnitAlias),
+                        Q_ALIGNOF(QmcUnitAlias), QMC_UNIT_COMPACT_DELTA_ALIAS))
             return false;
-        if (!writeDataWithLen(stream, (const char *)customParser.compilationArtifact.data(),
-                              customParser.compilationArtifact.size()))
+        break;
+    }
+    case QMC_SECTION_CUSTOM_PARSERS: {
+        foreach (const QmcUnitCustomParser &customParser, c->customParsers) {
+            if (!writeCount(customParser.objectIndex))
+                return false;
+            if (!writeDataWithLen((const char *)customParser.compilationArtifact.data(),
+                                  customParser.compilationArtifact.size()))
+                return false;
+            if (!writeBitArray(customParser.bindings))
+                return false;
+        }
+        break;
+    }
+    case QMC_SECTION_CUSTOM_PARSER_BINDINGS: {
+        if (!writeTable(c->customParserBindings.constData(), c->customParserBindings.size(),
+                        sizeof(quint32), sizeof(quint32), 0))
             return false;
-        if (!writeBitArray(stream, customParser.bindings))
+        break;
+    }
+    case QMC_SECTION_DEFERRED_BINDINGS: {
+        foreach (const QmcUnitDeferredBinding &deferredBinding, c->deferredBindings) {
+            if (!writeCount(deferredBinding.objectIndex))
+                return false;
+            if (!writeBitArray(deferredBinding.bindings))
+                return false;
+        }
+        break;
+    }
+    case QMC_SECTION_DEPENDENCIES: {
+        if (!writeCount(c->dependencies.size()))
             return false;
+        foreach (const QString &dependency, c->dependencies) {
+            if (!writeSharedString(dependency))
+                return false;
+        }
+        break;
     }
-
-    // custom parser bindings
-    foreach (int i, c->customParserBindings) {
-        quint32 d = (quint32)i;
-        if (!writeData(stream, (const char *)&d, sizeof (quint32)))
+    case QMC_SECTION_META_OBJECTS: {
+        if (!writeCount(c->metaObjects.size()))
             return false;
+        foreach (const QmcUnitMetaObject &metaObject, c->metaObjects) {
+            if (!writeCount(metaObject.objectIndex) || !writeCount(metaObject.propertyIndexCacheStart)
+                    || !writeCount(metaObject.methodIndexCacheStart) || !writeCount(metaObject.signalHandlerIndexCacheStart))
+                return false;
+            if (!writeDataWithLen(metaObject.data.constData(), metaObject.data.size()))
+                return false;
+        }
+        break;
     }
-
-    // deferred bindings
-    foreach (const QmcUnitDeferredBinding &deferredBinding, c->deferredBindings) {
-        if (!writeData(stream, (const char *)&deferredBinding.objectIndex, sizeof (quint32)))
+    case QMC_SECTION_TYPE_RESOLUTIONS: {
+        if (!writeCount(c->moduleFingerprint) || !writeCount(c->typeResolutions.size()))
             return false;
-        if (!writeBitArray(stream, deferredBinding.bindings))
+        foreach (const QmcUnitTypeResolution &resolution, c->typeResolutions) {
+            if (!writeCount(resolution.index) || !writeCount(resolution.kind)
+                    || !writeCount(resolution.majorVersion) || !writeCount(resolution.minorVersion))
+                return false;
+            if (!writeSharedString(resolution.name))
+                return false;
+        }
+        break;
+    }
+    case QMC_SECTION_CODE: {
+        if (!(header.flags & QMC_UNIT_FLAG_CODE_SECTION))
+            break;
+        if (!writeCodeSection(c, positionIndependentCode))
             return false;
+        break;
+    }
+    default:
+        break;
     }
-
     return true;
 }
@@ -27,6 +27,7 @@
 #include "qmccompiler_global.h"
 
 class QmlCompilation;
+class QmcPackagePoolWriter;
 
 class QMCCOMPILERSHARED_EXPORT QmcExporter : public QObject
 {
@@ -35,16 +36,42 @@ public:
     QmcExporter(QmlCompilation *compilation, QObject* parent = NULL);
 
     bool exportQmc(QDataStream &stream);
+    // unit is written to data in one pass
+    bool exportQmc(QByteArray &data);
+
+    // emit position independent code if supported by target, see QMC_UNIT_FLAG_PIC
+    void setPositionIndependentCode(bool positionIndependent);
+    // store code in a page aligned section, see QMC_UNIT_FLAG_CODE_SECTION
+    void setCodeSection(bool codeSection);
+    // compress sections that get smaller, see QMC_UNIT_SECTION_FLAG_COMPRESSED
+    void setCompression(bool compression);
+    // store counts and index tables as varints, see QMC_UNIT_FLAG_COMPACT_TABLES
+    void setCompactTables(bool compactTables);
+    // refer to constants and strings in the package pool, see QMC_UNIT_FLAG_SHARED_POOL
+    void setPackagePool(QmcPackagePoolWriter *pool);
 
 private:
     void createHeader(QmcUnitHeader &header, QmlCompilation *c);
-    bool writeQmcUnit(QmlCompilation *c, QDataStream &stream);
-    bool writeString(QDataStream& stream, QString string);
-    bool writeData(QDataStream& stream, const char *data, int len);
-    bool writeDataWithLen(QDataStream& stream, const char* data, int len);
-    bool writeBitArray(QDataStream& stream, const QBitArray& array);
+    bool createPositionIndependentCode(QmlCompilation *c, QList<QByteArray> &code);
+    bool writeCodeSection(QmlCompilation *c, const QList<QByteArray> &positionIndependentCode);
+    bool writeQmcUnit(QmlCompilation *c);
+    bool writeSection(QmlCompilation *c, const QmcUnitHeader &header, int id,
+                      const QList<QByteArray> &positionIndependentCode);
+    bool writeString(const QString &string);
+    bool writeSharedString(const QString &string);
+    bool writeData(const char *data, qint64 len, int alignment = 1);
+    bool writeDataWithLen(const char* data, qint64 len);
+    bool writeCount(quint32 count);
+    bool writeTable(const void *records, int count, int recordSize, int alignment, quint32 deltaMask);
+    bool writeBitArray(const QBitArray& array);
     QmlCompilation *compilation;
-
+    QByteArray *out;
+    qint64 sectionStart;
+    bool positionIndependent;
+    bool codeSection;
+    bool compression;
+    bool compactTables;
+    QmcPackagePoolWriter *pool;
 };
 
 #endif // QMCEXPORTER_H
@@ -19,6 +19,7 @@
 
 #include "qmcinstructionselection.h"
 #include "qmclinktable.h"
+#include "qmcrelocation.h"
 #include <private/qv4ssa_p.h>
 
 #include "AbstractMacroAssembler.h"
@@ -155,11 +156,21 @@ void QmcInstructionSelection::run(int functionIndex)
         calls.append(link);
     }
 
-    linkedCalls.append(calls);
+    // locations the constant table pointer is patched to in linking
+    Q_ASSERT(compilationUnit->constantValues.size() == functionIndex);
+    const QVector<Assembler::DataLabelPtr>& toPatch = _as->constantTable().toPatch();
+    for (int i = 0; i < toPatch.size(); i++) {
+        QmcUnitCodeRefLinkCall link;
+        link.index = QMC_LINK_INDEX_CONSTANT_TABLE;
+        link.offset = toPatch[i].m_label.m_offset;
+        calls.append(link);
+    }
 
     JSC::MacroAssemblerCodeRef codeRef =_as->link(&dummySize);
     compilationUnit->codeRefs[functionIndex] = codeRef;
 
+    linkedCalls.append(calls);
+
     qSwap(_function, function);
     delete _as;
     _as = oldAssembler;
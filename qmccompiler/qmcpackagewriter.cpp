@@ -0,0 +1,196 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#include <QFile>
+#include <QUrl>
+#include <QVector>
+
+#include <private/qv4value_p.h>
+
+#include "qmcpackagewriter.h"
+#include "qmcfile.h"
+
+#include <string.h>
+
+static quint64 align(quint64 offset, quint64 alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+QmcPackagePoolWriter::QmcPackagePoolWriter()
+{
+}
+
+quint32 QmcPackagePoolWriter::addString(const QString &string)
+{
+    QHash<QString, quint32>::const_iterator it = stringIndexes.constFind(string);
+    if (it != stringIndexes.constEnd())
+        return it.value();
+    const quint32 index = strings.size();
+    strings.append(string.toUtf8());
+    stringIndexes.insert(string, index);
+    return index;
+}
+
+quint32 QmcPackagePoolWriter::addConstants(const QV4::Primitive *constants, int count)
+{
+    // tables are compared as raw values, e.g. 0 and -0 are different
+    const QByteArray table((const char *)constants, count * sizeof (QV4::Primitive));
+    QHash<QByteArray, quint32>::const_iterator it = constantIndexes.constFind(table);
+    if (it != constantIndexes.constEnd())
+        return it.value();
+    const quint32 index = constantCount();
+    this->constants.append(table);
+    constantIndexes.insert(table, index);
+    return index;
+}
+
+int QmcPackagePoolWriter::constantCount() const
+{
+    return constants.size() / sizeof (QV4::Primitive);
+}
+
+QByteArray QmcPackagePoolWriter::stringData() const
+{
+    QVector<quint32> offsets;
+    QByteArray data;
+    foreach (const QByteArray &string, strings) {
+        offsets.append(data.size());
+        data.append(string);
+    }
+    offsets.append(data.size());
+    return QByteArray((const char *)offsets.constData(), offsets.size() * sizeof (quint32)) + data;
+}
+
+QmcPackageWriter::QmcPackageWriter()
+{
+}
+
+QmcPackagePoolWriter *QmcPackageWriter::pool()
+{
+    return &poolWriter;
+}
+
+bool QmcPackageWriter::addFile(const QString &name, const QString &file)
+{
+    QFile f(file);
+    if (!f.open(QFile::ReadOnly)) {
+        appendError("Could not open file for reading: " + f.errorString(), file);
+        return false;
+    }
+    return addUnit(name, f.readAll());
+}
+
+bool QmcPackageWriter::addUnit(const QString &name, const QByteArray &unit)
+{
+    if (unit.size() < (int)sizeof (QmcUnitHeader) || strncmp(unit.constData(), QMC_UNIT_MAGIC_STR, strlen(QMC_UNIT_MAGIC_STR))) {
+        appendError("Not a compiled unit", name);
+        return false;
+    }
+    const QByteArray key = name.toUtf8();
+    if (key.isEmpty() || units.contains(key)) {
+        appendError("Invalid or duplicate unit name", name);
+        return false;
+    }
+    units.insert(key, unit);
+    return true;
+}
+
+bool QmcPackageWriter::write(const QString &file)
+{
+    QmcPackageHeader header;
+    memset(&header, 0, sizeof (header));
+    memcpy(header.magic, QMC_PACKAGE_MAGIC_STR, sizeof (header.magic));
+    header.version = QMC_PACKAGE_VERSION;
+    header.entries = units.size();
+
+    // names follow the entries and the pool follows the names
+    const QByteArray strings = poolWriter.stringData();
+    quint64 namesOffset = sizeof (QmcPackageHeader) + sizeof (QmcPackagePoolHeader) + units.size() * sizeof (QmcPackageEntry);
+    quint64 offset = namesOffset;
+    foreach (const QByteArray &name, units.keys())
+        offset += name.size();
+    QmcPackagePoolHeader pool;
+    memset(&pool, 0, sizeof (pool));
+    pool.strings = poolWriter.stringCount();
+    pool.constants = poolWriter.constantCount();
+    pool.stringsOffset = align(offset, sizeof (quint32));
+    pool.constantsOffset = align(pool.stringsOffset + strings.size(), Q_ALIGNOF(QV4::Primitive));
+    offset = pool.constantsOffset + poolWriter.constantData().size();
+
+    // units are page aligned after the pool
+    QVector<QmcPackageEntry> entries;
+    QMap<QByteArray, QByteArray>::const_iterator it;
+    for (it = units.constBegin(); it != units.constEnd(); ++it) {
+        QmcPackageEntry entry;
+        memset(&entry, 0, sizeof (entry));
+        entry.nameOffset = namesOffset;
+        entry.nameLength = it.key().size();
+        offset = align(offset, QMC_PACKAGE_UNIT_ALIGNMENT);
+        entry.offset = offset;
+        entry.size = it.value().size();
+        entries.append(entry);
+        namesOffset += entry.nameLength;
+        offset += entry.size;
+    }
+
+    QFile f(file);
+    if (!f.open(QFile::WriteOnly | QFile::Truncate)) {
+        appendError("Could not open file for writing: " + f.errorString(), file);
+        return false;
+    }
+    bool ok = f.write((const char *)&header, sizeof (header)) == sizeof (header);
+    ok = ok && f.write((const char *)&pool, sizeof (pool)) == sizeof (pool);
+    if (!entries.isEmpty())
+        ok = ok && f.write((const char *)entries.constData(), entries.size() * sizeof (QmcPackageEntry)) == qint64(entries.size() * sizeof (QmcPackageEntry));
+    foreach (const QByteArray &name, units.keys())
+        ok = ok && f.write(name) == name.size();
+    ok = ok && writePadded(f, pool.stringsOffset, strings);
+    ok = ok && writePadded(f, pool.constantsOffset, poolWriter.constantData());
+    int i = 0;
+    foreach (const QByteArray &unit, units)
+        ok = ok && writePadded(f, entries[i++].offset, unit);
+    if (!ok) {
+        appendError("Could not write package: " + f.errorString(), file);
+        f.close();
+        f.remove();
+        return false;
+    }
+    return true;
+}
+
+bool QmcPackageWriter::writePadded(QFile &f, quint64 offset, const QByteArray &data)
+{
+    const qint64 padding = offset - f.pos();
+    if (padding < 0)
+        return false;
+    return f.write(QByteArray(padding, '\0')) == padding && f.write(data) == data.size();
+}
+
+const QList<QQmlError>& QmcPackageWriter::errors() const
+{
+    return errorList;
+}
+
+void QmcPackageWriter::appendError(const QString &description, const QString &file)
+{
+    QQmlError error;
+    error.setDescription(description);
+    error.setUrl(QUrl(file));
+    errorList.append(error);
+}
@@ -0,0 +1,124 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#ifndef QMCPACKAGEWRITER_H
+#define QMCPACKAGEWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QQmlError>
+#include <QString>
+
+#include "qmccompiler_global.h"
+
+namespace QV4 {
+struct Primitive;
+}
+
+// strings and constant tables shared by the units of a package, units
+// compiled with the pool refer to the entries by index, see
+// QMC_UNIT_FLAG_SHARED_POOL
+class QMCCOMPILERSHARED_EXPORT QmcPackagePoolWriter
+{
+public:
+    QmcPackagePoolWriter();
+
+    /**
+     * @brief addString
+     * Adds string to the pool unless it is there already
+     * @return
+     * Index of the string
+     */
+    quint32 addString(const QString &string);
+
+    /**
+     * @brief addConstants
+     * Adds constant table to the pool unless the same table is there already
+     * @return
+     * Index of the first constant of the table
+     */
+    quint32 addConstants(const QV4::Primitive *constants, int count);
+
+    int stringCount() const { return strings.size(); }
+    int constantCount() const;
+    // offsets and data as in QmcPackagePoolHeader
+    QByteArray stringData() const;
+    const QByteArray &constantData() const { return constants; }
+
+private:
+    QList<QByteArray> strings; // utf-8
+    QHash<QString, quint32> stringIndexes;
+    QByteArray constants;
+    QHash<QByteArray, quint32> constantIndexes;
+};
+
+class QMCCOMPILERSHARED_EXPORT QmcPackageWriter
+{
+public:
+    QmcPackageWriter();
+
+    /**
+     * @brief pool
+     * Pool shared by the units of the package, units have to be compiled
+     * with it before they are added, see Compiler::setPackagePool
+     */
+    QmcPackagePoolWriter *pool();
+
+    /**
+     * @brief addFile
+     * Adds compiled unit file to the package
+     * @param name
+     * Path of the unit relative to the directory of the package, the
+     * loader finds the unit from the package when this path is loaded
+     * @param file
+     * Compiled .qmc or .jsc file
+     * @return
+     * true if file was read and is a compiled unit
+     */
+    bool addFile(const QString &name, const QString &file);
+
+    /**
+     * @brief addUnit
+     * Adds compiled unit data to the package, see addFile
+     */
+    bool addUnit(const QString &name, const QByteArray &unit);
+
+    /**
+     * @brief write
+     * Writes the package with all added units
+     * @param file
+     * Output file, usually with .qmcpak extension
+     */
+    bool write(const QString &file);
+
+    const QList<QQmlError>& errors() const;
+
+private:
+    void appendError(const QString &description, const QString &file);
+    static bool writePadded(QFile &f, quint64 offset, const QByteArray &data);
+
+    // sorted by utf-8 name as required by the package index
+    QMap<QByteArray, QByteArray> units;
+    QmcPackagePoolWriter poolWriter;
+    QList<QQmlError> errorList;
+};
+
+#endif // QMCPACKAGEWRITER_H
@@ -24,6 +24,7 @@
 #include "qmcexporter.h"
 #include "qmlcompilation.h"
 #include "qmctypecompiler.h"
+#include "qmcmodulefingerprint.h"
 
 #include <private/qv4global_p.h>
 #include <private/qqmlcompiler_p.h>
@@ -311,6 +312,9 @@ bool QmlC::createExportStructures()
         compilation()->exportTypeRefs.append(typeRef);
     }
 
+    addTypeResolutions();
+    addComponentDependencies(compilation(), QString(), 0);
+
     // root object index to id mapping
     const QHash<int, int> &objectIdList = compilation()->compiledData->objectIndexToIdForRoot;
     for (QHash<int, int>::ConstIterator objectRef = objectIdList.constBegin(), end = objectIdList.constEnd();
@@ -371,6 +375,22 @@ bool QmlC::createExportStructures()
         }
     }
 
+    // VME meta data is reused by the loader while the base types keep the
+    // layout they have now
+    const QVector<QByteArray> &metaObjects = compilation()->compiledData->metaObjects;
+    const QVector<QQmlPropertyCache *> &propertyCaches = compilation()->compiledData->propertyCaches;
+    for (int i = 0; i < metaObjects.size() && i < propertyCaches.size(); i++) {
+        if (metaObjects.at(i).isEmpty() || !propertyCaches.at(i))
+            continue;
+        QmcUnitMetaObject metaObject;
+        metaObject.objectIndex = i;
+        metaObject.propertyIndexCacheStart = propertyCaches.at(i)->propertyIndexCacheStart;
+        metaObject.methodIndexCacheStart = propertyCaches.at(i)->methodIndexCacheStart;
+        metaObject.signalHandlerIndexCacheStart = propertyCaches.at(i)->signalHandlerIndexCacheStart;
+        metaObject.data = metaObjects.at(i);
+        compilation()->metaObjects.append(metaObject);
+    }
+
     const QHash<int, QQmlCompiledData::CustomParserData> &customParsers = compilation()->compiledData->customParserData;
     for (QHash<int, QQmlCompiledData::CustomParserData>::ConstIterator customParserRef = customParsers.constBegin(), end = customParsers.constEnd();
          customParserRef != end; customParserRef++) {
@@ -418,6 +438,80 @@ bool QmlC::compileData()
     return true;
 }
 
+// type references resolved at compile time with the fingerprint of the
+// imported modules, the loader uses these instead of resolving the names
+// again while the modules stay the same
+void QmlC::addTypeResolutions()
+{
+    const QQmlCompiledData *compiledData = compilation()->compiledData;
+    QmcModuleFingerprint fingerprint;
+    for (uint i = 0; i < compiledData->qmlUnit->nImports; i++) {
+        const QV4::CompiledData::Import *import = compiledData->qmlUnit->importAt(i);
+        if (import->type == QV4::CompiledData::Import::ImportLibrary)
+            fingerprint.addImport(compiledData->compilationUnit->data->stringAt(import->uriIndex), import->majorVersion);
+    }
+    compilation()->moduleFingerprint = fingerprint.value();
+
+    const QString url = compilation()->url.toString();
+    const QString baseUrl = url.left(url.lastIndexOf('/') + 1);
+    foreach (const QmcUnitTypeReference &typeRef, compilation()->exportTypeRefs) {
+        if (typeRef.syntheticComponent || !compilation()->typeReferences.contains(typeRef.index))
+            continue;
+        const QmlCompilation::TypeReference &ref = compilation()->typeReferences[typeRef.index];
+        QmcUnitTypeResolution resolution;
+        resolution.index = typeRef.index;
+        resolution.kind = QMC_TYPE_RESOLUTION_NONE;
+        resolution.majorVersion = ref.majorVersion;
+        resolution.minorVersion = ref.minorVersion;
+        if (ref.type && ref.composite) {
+            // composite types outside the directory of the unit are loaded by name
+            const QString sourceUrl = ref.type->sourceUrl().toString();
+            if (sourceUrl.startsWith(baseUrl)) {
+                resolution.kind = QMC_TYPE_RESOLUTION_COMPOSITE;
+                resolution.name = sourceUrl.mid(baseUrl.length());
+                int lastDot = resolution.name.lastIndexOf('.');
+                if (lastDot != -1)
+                    resolution.name = resolution.name.left(lastDot);
+            }
+        } else if (ref.type && !ref.type->qmlTypeName().isEmpty()) {
+            resolution.kind = QMC_TYPE_RESOLUTION_TYPE;
+            resolution.name = ref.type->qmlTypeName();
+        }
+        compilation()->typeResolutions.append(resolution);
+    }
+}
+
+// composite types used directly or through other components, with the
+// scripts those components import, composite types are loaded by file
+// name next to the unit using them, paths are relative to the root unit
+void QmlC::addComponentDependencies(const QmlCompilation *c, const QString &dir, int depth)
+{
+    if (depth > MAX_RECURSION)
+        return;
+    QList<QString> &dependencies = compilation()->dependencies;
+    foreach (const QmlCompilation::TypeReference &ref, c->typeReferences) {
+        if (!ref.composite || !ref.type || !ref.component)
+            continue;
+        const QString path = ref.type->sourceUrl().path();
+        const QString file = QDir::cleanPath(dir + path.mid(path.lastIndexOf('/') + 1));
+        if (dependencies.contains(file))
+            continue;
+        dependencies.append(file);
+
+        const QString componentDir = file.left(file.lastIndexOf('/') + 1);
+        const QQmlCompiledData *compiledData = ref.component->compiledData;
+        for (uint i = 0; compiledData && i < compiledData->qmlUnit->nImports; i++) {
+            const QV4::CompiledData::Import *import = compiledData->qmlUnit->importAt(i);
+            if (import->type != QV4::CompiledData::Import::ImportScript)
+                continue;
+            const QString script = QDir::cleanPath(componentDir + compiledData->compilationUnit->data->stringAt(import->uriIndex));
+            if (!dependencies.contains(script))
+                dependencies.append(script);
+        }
+        addComponentDependencies(ref.component, componentDir, depth + 1);
+    }
+}
+
 QmlCompilation* QmlC::getComponent(const QUrl& url)
 {
     //qDebug() << "Load dependency" << url.toString();
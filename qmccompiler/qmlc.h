@@ -51,6 +51,8 @@ private:
     bool doCompile();
     bool loadImplicitImport();
     QmlCompilation* getComponent(const QUrl& url);
+    void addTypeResolutions();
+    void addComponentDependencies(const QmlCompilation *c, const QString &dir, int depth);
 
     bool implicitImportLoaded;
     static int MAX_RECURSION;
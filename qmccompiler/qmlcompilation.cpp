@@ -17,6 +17,8 @@
 
 #include "qmlcompilation.h"
 #include "qmcfile.h"
+#include "qmclinktable.h"
+#include "qmcrelocation.h"
 
 #include <private/qv4compiler_p.h>
 #include <private/qqmlirbuilder_p.h>
@@ -31,6 +33,7 @@ QmlCompilation::QmlCompilation(const QString &urlString, const QUrl &url, QQmlEn
       compiledData(NULL),
       unit(NULL),
       engine(engine),
+      moduleFingerprint(0),
       document(NULL)
 {
     if (QQmlDebugService::isDebuggingEnabled())
@@ -52,132 +55,109 @@ QmlCompilation::~QmlCompilation()
         delete importDatabase;
 }
 
-int QmlCompilation::calculateSize() const
+// upper bounds of what QmcExporter writes, counts are 32-bit values with up
+// to 3 bytes of padding or varints of up to 5 bytes
+static const qint64 countSize = 2 * sizeof (quint32) - 1;
+static const qint64 padding = QMC_UNIT_DATA_ALIGNMENT - 1;
+
+static qint64 stringSize(const QString &string)
 {
-    int sizeInBytes = -1;
-    checkData(&sizeInBytes);
-    return sizeInBytes;
+    // utf-8 takes at most 3 bytes per utf-16 code unit, pooled strings
+    // are only an index
+    return countSize + 3 * qint64(string.length());
 }
 
-bool QmlCompilation::checkData(int *sizeInBytes) const
+static qint64 tableSize(qint64 count, qint64 recordSize)
 {
-    // header
-    int s = 0;
-    int size = sizeof (QmcUnitHeader);
-    if (sizeInBytes)
-        *sizeInBytes = -1;
-    if (type != QMC_QML && type != QMC_JS)
-        return false;
-    if (qmlUnit->qmlUnitSize > QMC_UNIT_MAX_QML_UNIT_SIZE)
-        return false;
-    if (unit->data->unitSize > QMC_UNIT_MAX_COMPILATION_UNIT_SIZE)
-        return false;
-    if (qmlUnit->nImports > QMC_UNIT_MAX_IMPORTS)
-        return false;
-    uint stringCount = unit->data->stringTableSize;
-    if (stringCount > QMC_UNIT_MAX_STRINGS)
-        return false;
-    if (namespaces.size() > QMC_UNIT_MAX_NAMESPACES)
-        return false;
-    if (exportTypeRefs.size() > QMC_UNIT_MAX_TYPE_REFERENCES)
-        return false;
-    QV4::JIT::CompilationUnit *compilationUnit = (QV4::JIT::CompilationUnit *)unit;
-    if (compilationUnit->codeRefs.size() > QMC_UNIT_MAX_CODE_REFS)
-        return false;
-    if (linkData.size() != compilationUnit->codeRefs.size())
-        return false;
-    if (compilationUnit->constantValues.size() != linkData.size())
-        return false;
-    if (objectIndexToIdRoot.size() > QMC_UNIT_MAX_OBJECT_INDEX_TO_ID_ROOT)
-        return false;
-    if (objectIndexToIdComponent.size() > QMC_UNIT_MAX_OBJECT_INDEX_TO_ID_COMPONENT)
-        return false;
-    if (aliases.size() > QMC_UNIT_MAX_ALIASES)
-        return false;
-    if (customParsers.size() > QMC_UNIT_MAX_CUSTOM_PARSERS)
-        return false;
-    if (customParserBindings.size() > QMC_UNIT_MAX_CUSTOM_PARSER_BINDINGS)
-        return false;
-    if (deferredBindings.size() > QMC_UNIT_MAX_DEFERRED_BINDINGS)
-        return false;
-
-    if (name.length() > QMC_UNIT_NAME_MAX_LEN)
-        return false;
-    if (url.toString().length() > QMC_UNIT_URL_MAX_LEN)
-        return false;
+    // aligned records, or varints of up to 5 bytes per 32-bit field
+    return count * recordSize * 5 / 4 + padding;
+}
 
-    size += name.length() + 4;
-    size += urlString.length() + 4;
+static qint64 bitArraySize(int bits)
+{
+    // 32-bit words, or bytes with compact tables
+    return countSize + QMC_UNIT_BIT_ARRAY_LENGTH(bits) * sizeof (quint32) + padding;
+}
 
-    size += qmlUnit->nImports * sizeof(QV4::CompiledData::Import);
+qint64 QmlCompilation::calculateSize(bool codeSection) const
+{
+    if (!checkData())
+        return -1;
+    QV4::JIT::CompilationUnit *compilationUnit = (QV4::JIT::CompilationUnit *)unit;
 
-    for (uint i = 0; i < stringCount; i++) {
-        s = compilationUnit->data->stringAt(i).length();
-        if (s > QMC_UNIT_STRING_MAX_LEN)
-            return false;
-        size += s + 4;
+    // section directory and section alignment are added by the exporter
+    qint64 size = stringSize(name) + stringSize(urlString);
+    size += qmlUnit->qmlUnitSize + padding;
+    size += unit->data->unitSize + padding;
+    size += qint64(qmlUnit->nImports) * sizeof (QV4::CompiledData::Import) + padding;
+
+    foreach (const QString &ns, namespaces)
+        size += stringSize(ns);
+
+    size += tableSize(exportTypeRefs.size(), sizeof (QmcUnitTypeReference));
+
+    // code is in the code section or with its code ref, position
+    // independent code has the same size
+    QVector<quint32> codeRefSizes;
+    QVector<quint32> constantTableSizes;
+    for (int i = 0; i < compilationUnit->codeRefs.size(); i++) {
+        codeRefSizes.append(compilationUnit->codeRefs[i].size());
+        constantTableSizes.append(compilationUnit->constantValues[i].size());
+        size += countSize;
+        if (!codeSection)
+            size += compilationUnit->codeRefs[i].size();
+        size += countSize + tableSize(linkData[i].size(), sizeof (QmcUnitCodeRefLinkCall));
+        size += countSize + qint64(compilationUnit->constantValues[i].size()) * sizeof (QV4::Primitive) + padding;
     }
-
-    foreach (const QString &ns, namespaces) {
-        s = ns.length();
-        if (s > QMC_UNIT_STRING_MAX_LEN)
-            return false;
-        size += s + 4;
+    if (codeSection) {
+        // position independent layout is the larger one
+        const QmcCodeLayout layout(codeRefSizes, constantTableSizes, true,
+                                   sizeof (QMC_LINK_TABLE) / sizeof (QmcLinkEntry));
+        size += layout.size;
     }
 
-    size += exportTypeRefs.size() * sizeof (QmcUnitTypeReference);
+    size += tableSize(objectIndexToIdRoot.size(), sizeof (QmcUnitObjectIndexToId));
 
-    foreach (const JSC::MacroAssemblerCodeRef &codeRef, compilationUnit->codeRefs) {
-        s = codeRef.size();
-        if (s > QMC_UNIT_MAX_CODE_REF_SIZE)
-            return false;
-        size += s + 4;
-    }
+    foreach (const QmcUnitObjectIndexToIdComponent &componentMap, objectIndexToIdComponent)
+        size += 2 * countSize + tableSize(componentMap.mappings.size(), sizeof (QmcUnitObjectIndexToId));
 
-    foreach (const QVector<QmcUnitCodeRefLinkCall>& linkedCalls, linkData) {
-        if (linkedCalls.size() > QMC_UNIT_MAX_CODE_REF_LINK_CALLS)
-            return false;
-        size += linkedCalls.size() * sizeof (QmcUnitCodeRefLinkCall) + sizeof(quint32);
-    }
+    size += tableSize(aliases.size(), sizeof (QmcUnitAlias));
 
-    foreach (const QVector<QV4::Primitive > & vec, compilationUnit->constantValues) {
-        if (vec.size() > QMC_UNIT_MAX_CONSTANT_VECTOR_SIZE)
-            return false;
-        size += vec.size() * sizeof (QV4::Primitive) + 4;
+    foreach (const QmcUnitCustomParser &customParser, customParsers) {
+        size += 2 * countSize + customParser.compilationArtifact.size();
+        size += bitArraySize(customParser.bindings.size());
     }
 
-    size += objectIndexToIdRoot.size() * sizeof (QmcUnitObjectIndexToId);
-
-    size += objectIndexToIdComponent.size() * sizeof (quint32);
-    foreach (const QmcUnitObjectIndexToIdComponent &componentMap, objectIndexToIdComponent) {
-        if (componentMap.mappings.size() > QMC_UNIT_MAX_OBJECT_INDEX_TO_ID_COMPONENT_MAPPINGS)
-            return false;
-        size += componentMap.mappings.size() * sizeof (QmcUnitObjectIndexToId);
-    }
+    size += tableSize(customParserBindings.size(), sizeof (quint32));
 
-    size += aliases.size() * sizeof (QmcUnitAlias);
+    foreach (const QmcUnitDeferredBinding &binding, deferredBindings)
+        size += countSize + bitArraySize(binding.bindings.size());
 
-    foreach (const QmcUnitCustomParser& customParser, customParsers) {
-        size += sizeof (quint32);
-        if (customParser.compilationArtifact.size() > QMC_UNIT_MAX_CUSTOM_PARSER_DATA_LENGTH)
-            return false;
-        size += customParser.compilationArtifact.size();
-        if (customParser.bindings.size() > QMC_UNIT_MAX_CUSTOM_PARSER_BINDING_LENGTH)
-            return false;
-        size += QMC_UNIT_BIT_ARRAY_LENGTH(customParser.bindings.size());
-    }
+    size += countSize;
+    foreach (const QString &dependency, dependencies)
+        size += stringSize(dependency);
 
-    size += customParserBindings.size() * sizeof (quint32);
+    size += countSize;
+    foreach (const QmcUnitMetaObject &metaObject, metaObjects)
+        size += 5 * countSize + metaObject.data.size();
 
-    foreach (const QmcUnitDeferredBinding &binding, deferredBindings) {
-        size += sizeof (quint32);
-        if (binding.bindings.size() > QMC_UNIT_MAX_DEFERRED_BINDING_LENGTH)
-            return false;
-        size += QMC_UNIT_BIT_ARRAY_LENGTH(binding.bindings.size());
-    }
+    size += 2 * countSize;
+    foreach (const QmcUnitTypeResolution &resolution, typeResolutions)
+        size += 4 * countSize + stringSize(resolution.name);
 
-    if (sizeInBytes)
-        *sizeInBytes = size;
+    return size;
+}
 
+bool QmlCompilation::checkData() const
+{
+    // counts and sizes are not limited, only the data written for each
+    // code ref has to be consistent
+    if (type != QMC_QML && type != QMC_JS)
+        return false;
+    QV4::JIT::CompilationUnit *compilationUnit = (QV4::JIT::CompilationUnit *)unit;
+    if (linkData.size() != compilationUnit->codeRefs.size())
+        return false;
+    if (compilationUnit->constantValues.size() != linkData.size())
+        return false;
     return true;
 }
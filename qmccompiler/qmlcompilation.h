@@ -30,8 +30,10 @@ public:
     QUrl loadUrl;
     QString code;
     QQmlCompiledData *compiledData;
-    bool checkData(int *sizeInBytes = NULL) const;
-    int calculateSize() const;
+    bool checkData() const;
+    // upper bound of the exported unit without the section directory and
+    // section alignment, -1 if the data is inconsistent
+    qint64 calculateSize(bool codeSection) const;
 
     QV4::CompiledData::QmlUnit *qmlUnit;
     QV4::CompiledData::CompilationUnit *unit;
@@ -41,6 +43,8 @@ public:
     QList<QString> namespaces;
 
     QList<QmcUnitTypeReference> exportTypeRefs;
+    QList<QmcUnitTypeResolution> typeResolutions;
+    quint32 moduleFingerprint;
 
     QmcFileType type;
 
@@ -51,6 +55,11 @@ public:
     QList<QmcUnitCustomParser> customParsers;
     QVector<int> customParserBindings;
     QList<QmcUnitDeferredBinding> deferredBindings;
+    QList<QmcUnitMetaObject> metaObjects;
+
+    // composite types and scripts used by the unit and, transitively, by
+    // its composite types, relative to the unit
+    QList<QString> dependencies;
 
     QmlIR::Document* document;
     QQmlImports* importCache;
@@ -0,0 +1,128 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#include "qmccompilationunit.h"
+
+#include <private/qv4engine_p.h>
+#include <private/qv4function_p.h>
+#include <private/qv4context_p.h>
+#include <private/qv4executableallocator_p.h>
+
+#include "ExecutableAllocator.h"
+
+#include "qmcunit.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+QT_BEGIN_NAMESPACE
+
+typedef QV4::ReturnedValue (*QmcFunctionCode)(QV4::ExecutionContext *, const uchar *);
+
+QmcCompilationUnit::QmcCompilationUnit()
+    : qmlUnitCopy(NULL),
+      codeMapping(NULL),
+      codeMappingSize(0)
+{
+}
+
+QmcCompilationUnit::~QmcCompilationUnit()
+{
+    // unlink while the data it checks and frees is still there
+    unlink();
+    free(qmlUnitCopy);
+    if (codeMapping)
+        munmap(codeMapping, codeMappingSize);
+}
+
+void QmcCompilationUnit::addLazyFunction(int index, const char *code, quint32 size,
+                                         const QmcUnitTable<QmcUnitCodeRefLinkCall> &linkCalls)
+{
+    Q_ASSERT(!engine);
+    QmcLazyFunction function;
+    function.compilationUnit = this;
+    function.index = index;
+    function.code = code;
+    function.size = size;
+    function.linkCalls = linkCalls;
+    lazyFunctions.append(function);
+}
+
+void QmcCompilationUnit::setFileData(const QSharedPointer<QmcUnitData> &fileData)
+{
+    this->fileData = fileData;
+}
+
+void QmcCompilationUnit::setQmlUnitCopy(void *qmlUnit)
+{
+    Q_ASSERT(!qmlUnitCopy);
+    qmlUnitCopy = qmlUnit;
+}
+
+void QmcCompilationUnit::setCodeMapping(void *mapping, qint64 size)
+{
+    Q_ASSERT(!codeMapping);
+    codeMapping = mapping;
+    codeMappingSize = size;
+}
+
+void QmcCompilationUnit::linkBackendToEngine(QV4::ExecutionEngine *engine)
+{
+    QV4::JIT::CompilationUnit::linkBackendToEngine(engine);
+    // code refs of lazy functions are empty until called
+    for (int i = 0; i < lazyFunctions.size(); i++) {
+        const QmcLazyFunction *function = lazyFunctions.constData() + i;
+        QV4::Function *runtimeFunction = runtimeFunctions[function->index];
+        runtimeFunction->code = lazyCall;
+        runtimeFunction->codeData = reinterpret_cast<const uchar *>(function);
+    }
+}
+
+QV4::ReturnedValue QmcCompilationUnit::lazyCall(QV4::ExecutionContext *ctx, const uchar *data)
+{
+    const QmcLazyFunction *function = reinterpret_cast<const QmcLazyFunction *>(data);
+    QmcCompilationUnit *compilationUnit = function->compilationUnit;
+    QV4::Function *runtimeFunction = compilationUnit->runtimeFunctions[function->index];
+    if (!compilationUnit->linkFunction(*function))
+        return ctx->throwError(QStringLiteral("Could not link function code"));
+    return runtimeFunction->code(ctx, runtimeFunction->codeData);
+}
+
+bool QmcCompilationUnit::linkFunction(const QmcLazyFunction &function)
+{
+    // same as non position independent code linked with the unit, but in
+    // an allocation of its own
+    RefPtr<JSC::ExecutableMemoryHandle> memory = adoptRef(new JSC::ExecutableMemoryHandle(engine->executableAllocator, function.size));
+    char *dst = (char *)memory->start();
+    if (!dst)
+        return false;
+    JSC::ExecutableAllocator::makeWritable(dst, function.size);
+    memcpy(dst, function.code, function.size);
+    if (!QmcUnit::linkCode(dst, function.size, function.linkCalls, constantValues[function.index]))
+        return false;
+    JSC::ExecutableAllocator::makeExecutable(dst, function.size);
+    JSC::MacroAssembler::cacheFlush(dst, function.size);
+
+    codeRefs[function.index] = JSC::MacroAssemblerCodeRef(memory.release());
+    QV4::Function *runtimeFunction = runtimeFunctions[function.index];
+    runtimeFunction->code = (QmcFunctionCode)dst;
+    runtimeFunction->codeData = NULL;
+    return true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,81 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#ifndef QMCCOMPILATIONUNIT_H
+#define QMCCOMPILATIONUNIT_H
+
+#include <QVector>
+#include <QSharedPointer>
+
+#include <private/qv4assembler_p.h>
+
+#include "qmcfile.h"
+#include "qmcunitreader.h"
+#include "qmcunitcache.h"
+
+QT_BEGIN_NAMESPACE
+
+class QmcCompilationUnit;
+
+// code of a function linked on its first call, the stub installed for it
+// gets the function through codeData which is otherwise unused by jit code
+struct QmcLazyFunction
+{
+    QmcCompilationUnit *compilationUnit;
+    int index;
+    const char *code;
+    quint32 size;
+    QmcUnitTable<QmcUnitCodeRefLinkCall> linkCalls;
+};
+
+// compilation unit of a qmc unit, functions which are not needed when the
+// unit is first used get their code linked only when they are called
+class QmcCompilationUnit : public QV4::JIT::CompilationUnit
+{
+public:
+    QmcCompilationUnit();
+    virtual ~QmcCompilationUnit();
+
+    // data, qml unit and code are read in place from fileData, it has to
+    // stay valid for as long as the compilation unit exists since compiled
+    // data of the engine may outlive the qmc unit
+    void addLazyFunction(int index, const char *code, quint32 size, const QmcUnitTable<QmcUnitCodeRefLinkCall> &linkCalls);
+    void setFileData(const QSharedPointer<QmcUnitData> &fileData);
+    // copied qml unit, freed with the compilation unit
+    void setQmlUnitCopy(void *qmlUnit);
+    // code mapped for this compilation unit only, unmapped with it
+    void setCodeMapping(void *mapping, qint64 size);
+    int lazyFunctionCount() const { return lazyFunctions.size(); }
+
+protected:
+    virtual void linkBackendToEngine(QV4::ExecutionEngine *engine);
+
+private:
+    static QV4::ReturnedValue lazyCall(QV4::ExecutionContext *ctx, const uchar *data);
+    bool linkFunction(const QmcLazyFunction &function);
+
+    QVector<QmcLazyFunction> lazyFunctions; // not resized once linked to engine
+    QSharedPointer<QmcUnitData> fileData;
+    void *qmlUnitCopy;
+    void *codeMapping;
+    qint64 codeMappingSize;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMCCOMPILATIONUNIT_H
@@ -17,10 +17,20 @@
 
 #include <QQmlEngine>
 #include <QMap>
+#include <QSet>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <QQmlComponent>
 
 #include <private/qv4isel_moth_p.h>
+#include <private/qv4isel_masm_p.h>
 #include <private/qobject_p.h>
 #include <private/qqmlcompiler_p.h>
 #include <private/qqmlcomponent_p.h>
@@ -30,9 +40,40 @@
 #include "qmcfile.h"
 #include "qmcunit.h"
 #include "qmctypeunit.h"
+#include "qmcpackage.h"
+#include "qmcunitcache.h"
+#include "qmcmodulefingerprint.h"
 
 static int DEPENDENCY_MAX_RECURSION_DEPTH = 10;
 
+// unit read from file, in a worker thread for asynchronous loads
+struct QmcLoadRequest
+{
+    QmcLoadRequest()
+        : fileMapping(false),
+          engine(NULL),
+          loader(NULL),
+          readDependencies(false),
+          sourceFallback(false),
+          found(false),
+          unit(NULL)
+    {
+    }
+
+    QString file;
+    QList<QmcPackage *> packages;
+    bool fileMapping;
+    QQmlEngine *engine;
+    QmcLoader *loader;
+    bool readDependencies;
+    bool sourceFallback; // units older than their source are not read
+    QSet<QString> loaded; // loaded urls of units the loader has already
+    bool found; // unit exists and is not older than its source
+    QmcUnit *unit;
+    QList<QQmlError> errors;
+    QList<QmcUnit *> dependencies; // read by level, not attached
+};
+
 class QmcLoaderPrivate : public QObjectPrivate
 {
     Q_DECLARE_PUBLIC(QmcLoader)
@@ -43,14 +84,25 @@ public:
     QList<QQmlError> errors;
     QmcTypeUnit* unit;
     QMap<QString, QmcUnit *> dependencies;
+    QList<QmcPackage *> packages;
     bool loadDependenciesAutomatically;
+    bool fileMapping;
+    bool lazyLinking;
+    bool sourceFallback;
     int dependencyRecursionDepth;
+    QList<QFutureWatcher<QmcLoadRequest> *> asyncLoads;
+    QHash<QString, QByteArray> moduleFingerprints; // by uri and version
+
+    QmcLoadRequest createRequest(const QString &file);
 };
 
 QmcLoaderPrivate::QmcLoaderPrivate(QQmlEngine *engine)
     : engine(engine),
       unit(NULL),
       loadDependenciesAutomatically(true),
+      fileMapping(true),
+      lazyLinking(false),
+      sourceFallback(false),
       dependencyRecursionDepth(0)
 {
 }
@@ -64,6 +116,31 @@ QmcLoaderPrivate::~QmcLoaderPrivate()
         unit->blob->release();
     }
     dependencies.clear();
+
+    // workers use the packages, units not attached yet are only deleted
+    foreach (QFutureWatcher<QmcLoadRequest> *watcher, asyncLoads) {
+        watcher->waitForFinished();
+        delete watcher->result().unit;
+        qDeleteAll(watcher->result().dependencies);
+        delete watcher;
+    }
+    asyncLoads.clear();
+    qDeleteAll(packages);
+}
+
+QmcLoadRequest QmcLoaderPrivate::createRequest(const QString &file)
+{
+    Q_Q(QmcLoader);
+    QmcLoadRequest request;
+    request.file = file;
+    request.packages = packages;
+    request.fileMapping = fileMapping;
+    request.engine = engine;
+    request.loader = q;
+    request.readDependencies = loadDependenciesAutomatically;
+    request.sourceFallback = sourceFallback;
+    request.loaded = dependencies.keys().toSet();
+    return request;
 }
 
 QmcLoader::QmcLoader(QQmlEngine *engine, QObject *parent) :
@@ -71,20 +148,192 @@ QmcLoader::QmcLoader(QQmlEngine *engine, QObject *parent) :
 {
 }
 
-QQmlComponent *QmcLoader::loadComponent(const QString &file)
+QmcLoadRequest QmcLoader::readUnit(QmcLoadRequest request)
 {
-    QFile f(file);
-    if (!f.open(QFile::ReadOnly)) {
+    const QString &file = request.file;
+    // packages replace the files they contain
+    foreach (const QmcPackage *package, request.packages) {
+        int entry = package->find(file);
+        if (entry < 0)
+            continue;
+        request.found = true;
+        request.unit = QmcUnit::readUnit(package, entry, request.engine, request.loader, createLoadedUrl(file));
+        if (!request.unit) {
+            QQmlError error;
+            error.setDescription("Error parsing / loading");
+            error.setUrl(QUrl(file));
+            request.errors.append(error);
+        }
+        return request;
+    }
+
+    if (request.sourceFallback && !isUpToDate(file)) {
         QQmlError error;
-        error.setDescription("Could not open file for reading");
-        appendError(error);
+        error.setDescription("Precompiled file is older than its source");
+        error.setUrl(QUrl(file));
+        request.errors.append(error);
+        return request;
+    }
+
+    // file data is shared by all loaders and engines of the process
+    QString errorString;
+    QSharedPointer<QmcUnitData> fileData = QmcUnitCache::file(file, request.fileMapping, &errorString);
+    request.found = fileData || QFileInfo(file).exists();
+    if (!fileData) {
+        QQmlError error;
+        error.setDescription("Could not open file for reading: " + errorString);
+        error.setUrl(QUrl(file));
+        request.errors.append(error);
+        return request;
+    }
+    request.unit = QmcUnit::readUnit(fileData, request.engine, request.loader, createLoadedUrl(file));
+
+    if (!request.unit) {
+        QQmlError error;
+        error.setDescription("Error parsing / loading");
+        error.setUrl(QUrl(file));
+        request.errors.append(error);
+    } else if (request.readDependencies) {
+        readDependencies(request);
+    }
+    return request;
+}
+
+void QmcLoader::readDependencies(QmcLoadRequest &request)
+{
+    // the units listed by the unit are read level by level, units of a
+    // level in parallel, failures are reported when linking needs them
+    QmcLoadRequest dependencyRequest;
+    dependencyRequest.packages = request.packages;
+    dependencyRequest.fileMapping = request.fileMapping;
+    dependencyRequest.engine = request.engine;
+    dependencyRequest.loader = request.loader;
+    dependencyRequest.sourceFallback = request.sourceFallback;
+
+    QSet<QString> seen = request.loaded;
+    seen.insert(request.unit->loadedUrl.toString());
+    QList<QmcUnit *> level;
+    level.append(request.unit);
+    for (int depth = 0; depth < DEPENDENCY_MAX_RECURSION_DEPTH && !level.isEmpty(); depth++) {
+        QList<QmcLoadRequest> requests;
+        foreach (const QmcUnit *unit, level) {
+            foreach (const QString &dependency, unit->dependencyFiles) {
+                const QString file = fileForUrl(QUrl(precompiledUrl(getBaseUrl(unit->loadedUrl) + dependency)));
+                const QString loadedUrl = createLoadedUrl(file).toString();
+                if (file.isEmpty() || seen.contains(loadedUrl))
+                    continue;
+                seen.insert(loadedUrl);
+                dependencyRequest.file = file;
+                requests.append(dependencyRequest);
+            }
+        }
+        // units list their dependencies transitively, so usually the whole
+        // tree is requested from the kernel at once before any is read
+        foreach (const QmcLoadRequest &dependency, requests)
+            prefetch(dependency.packages, dependency.file);
+        level.clear();
+        foreach (const QmcLoadRequest &result, QtConcurrent::blockingMapped(requests, &QmcLoader::readUnit)) {
+            if (result.unit)
+                level.append(result.unit);
+        }
+        request.dependencies.append(level);
+    }
+}
+
+void QmcLoader::prefetch(const QList<QmcPackage *> &packages, const QString &file)
+{
+    foreach (const QmcPackage *package, packages) {
+        int entry = package->find(file);
+        if (entry >= 0) {
+            package->prefetch(entry);
+            return;
+        }
+    }
+    // resources and missing files are skipped
+    int fd = ::open(QFile::encodeName(file).constData(), O_RDONLY);
+    if (fd < 0)
+        return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+}
+
+void QmcLoader::attachDependencies(const QList<QmcUnit *> &units)
+{
+    Q_D(QmcLoader);
+    // deepest level first, units are attached after the ones they use
+    for (int i = units.size() - 1; i >= 0; i--) {
+        QmcUnit *unit = units.at(i);
+        // another load may have added it meanwhile
+        if (d->dependencies.contains(unit->loadedUrl.toString())) {
+            delete unit;
+            continue;
+        }
+        unit = QmcUnit::attach(unit);
+        if (!unit)
+            continue;
+        addDependency(unit);
+        unit->blob->release();
+    }
+}
+
+QmcUnit *QmcLoader::attachUnit(QmcUnit *unit, const QString &file)
+{
+    if (!unit)
         return NULL;
+    unit = QmcUnit::attach(unit);
+    if (!unit) {
+        QQmlError error;
+        error.setDescription("Error linking");
+        error.setUrl(QUrl(file));
+        appendError(error);
     }
+    return unit;
+}
+
+QmcUnit *QmcLoader::loadUnit(const QString &file)
+{
+    Q_D(QmcLoader);
+    QmcLoadRequest request = readUnit(d->createRequest(file));
+    appendErrors(request.errors);
+    attachDependencies(request.dependencies);
+    return attachUnit(request.unit, file);
+}
+
+QQmlComponent *QmcLoader::loadComponent(const QString &file)
+{
+    clearError();
+    QmcUnit *unit = loadUnit(file);
+    if (!unit)
+        return NULL;
+    return createComponent(unit);
+}
+
+void QmcLoader::loadComponentAsync(const QString &file)
+{
+    Q_D(QmcLoader);
+    QFutureWatcher<QmcLoadRequest> *watcher = new QFutureWatcher<QmcLoadRequest>;
+    connect(watcher, SIGNAL(finished()), this, SLOT(asyncLoadFinished()));
+    d->asyncLoads.append(watcher);
+    watcher->setFuture(QtConcurrent::run(&QmcLoader::readUnit, d->createRequest(file)));
+}
+
+void QmcLoader::asyncLoadFinished()
+{
+    Q_D(QmcLoader);
+    QFutureWatcher<QmcLoadRequest> *watcher = static_cast<QFutureWatcher<QmcLoadRequest> *>(sender());
+    if (!d->asyncLoads.removeOne(watcher))
+        return;
+    QmcLoadRequest request = watcher->result();
+    watcher->deleteLater();
 
-    QDataStream in(&f);
-    QQmlComponent *ret = loadComponent(in, createLoadedUrl(file));
-    f.close();
-    return ret;
+    clearError();
+    appendErrors(request.errors);
+    QQmlComponent *component = NULL;
+    attachDependencies(request.dependencies);
+    QmcUnit *unit = attachUnit(request.unit, request.file);
+    if (unit)
+        component = createComponent(unit);
+    emit componentLoaded(request.file, component);
 }
 
 QQmlComponent *QmcLoader::loadComponent(QDataStream &stream, const QUrl &loadedUrl)
@@ -99,7 +348,63 @@ QQmlComponent *QmcLoader::loadComponent(QDataStream &stream, const QUrl &loadedU
         appendError(error);
         return NULL;
     }
+    return createComponent(unit);
+}
+
+QQmlComponent *QmcLoader::loadComponent(const uchar *data, qint64 size, const QUrl &loadedUrl)
+{
+    clearError();
+    Q_D(QmcLoader);
+    QmcUnit *unit = QmcUnit::loadUnit(data, size, d->engine, this, loadedUrl);
+    if (!unit) {
+        QQmlError error;
+        error.setDescription("Error parsing / loading");
+        appendError(error);
+        return NULL;
+    }
+    return createComponent(unit);
+}
+
+QQmlComponent *QmcLoader::loadSource(const QUrl &source)
+{
+    Q_D(QmcLoader);
+    QmcLoadRequest request = d->createRequest(fileForUrl(QUrl(precompiledUrl(source.toString()))));
+    request.sourceFallback = true;
+    clearError();
+    if (!request.file.isEmpty()) {
+        request = readUnit(request);
+        attachDependencies(request.dependencies);
+        const bool read = request.unit;
+        QmcUnit *unit = QmcUnit::attach(request.unit);
+        if (unit)
+            return createComponent(unit);
+        if (read) {
+            QQmlError error;
+            error.setDescription("Could not link code");
+            error.setUrl(QUrl(request.file));
+            request.errors.append(error);
+        }
+        // a missing or outdated unit is expected, a broken one is not
+        if (request.found) {
+            foreach (const QQmlError &error, request.errors)
+                qWarning() << "Precompiled file rejected, using source:" << error.toString();
+        }
+    }
+
+    // no usable unit, the engine compiles the source
+    useJit(d->engine);
+    QQmlComponent *component = new QQmlComponent(d->engine, source, QQmlComponent::PreferSynchronous);
+    if (component->isError()) {
+        appendErrors(component->errors());
+        delete component;
+        return NULL;
+    }
+    return component;
+}
 
+QQmlComponent *QmcLoader::createComponent(QmcUnit *unit)
+{
+    Q_D(QmcLoader);
     if (unit->type != QMC_QML) {
         QQmlError error;
         error.setDescription("Cannot have Script unit as main unit");
@@ -135,6 +440,22 @@ QQmlComponent *QmcLoader::loadComponent(QDataStream &stream, const QUrl &loadedU
     return component;
 }
 
+bool QmcLoader::addPackage(const QString &file)
+{
+    Q_D(QmcLoader);
+    clearError();
+    QmcPackage *package = QmcPackage::open(file, d->fileMapping);
+    if (!package) {
+        QQmlError error;
+        error.setDescription("Could not open package");
+        error.setUrl(QUrl(file));
+        appendError(error);
+        return false;
+    }
+    d->packages.append(package);
+    return true;
+}
+
 void QmcLoader::setLoadDependenciesAutomatically(bool load)
 {
     Q_D(QmcLoader);
@@ -147,6 +468,30 @@ bool QmcLoader::isLoadDependenciesAutomatically() const
     return d->loadDependenciesAutomatically;
 }
 
+void QmcLoader::setFileMappingEnabled(bool enabled)
+{
+    Q_D(QmcLoader);
+    d->fileMapping = enabled;
+}
+
+bool QmcLoader::isFileMappingEnabled() const
+{
+    const Q_D(QmcLoader);
+    return d->fileMapping;
+}
+
+void QmcLoader::setLazyLinkingEnabled(bool enabled)
+{
+    Q_D(QmcLoader);
+    d->lazyLinking = enabled;
+}
+
+bool QmcLoader::isLazyLinkingEnabled() const
+{
+    const Q_D(QmcLoader);
+    return d->lazyLinking;
+}
+
 QUrl QmcLoader::createLoadedUrl(const QString &file)
 {
     QString urlStr;
@@ -158,6 +503,91 @@ QUrl QmcLoader::createLoadedUrl(const QString &file)
     return QUrl(urlStr);
 }
 
+// inverse of createLoadedUrl, resource urls map back to resource paths
+QString QmcLoader::fileForUrl(const QUrl &url)
+{
+    if (url.scheme() == "qrc") {
+        QString path = url.path();
+        if (!path.startsWith(':'))
+            path.prepend(':');
+        return path;
+    }
+    return url.toLocalFile();
+}
+
+// source file next to the precompiled file, empty if there is none
+QString QmcLoader::sourceFile(const QString &file)
+{
+    if (file.endsWith(".jsc"))
+        return file.left(file.size() - 1);
+    if (file.endsWith(".qmc"))
+        return file.left(file.size() - 1) + 'l';
+    return QString();
+}
+
+QUrl QmcLoader::sourceUrl(const QString &url)
+{
+    const QString file = fileForUrl(QUrl(url));
+    if (file.isEmpty())
+        return QUrl();
+    if (file.startsWith(':'))
+        return QUrl("qrc:" + file.mid(1));
+    return QUrl::fromLocalFile(file);
+}
+
+// resources and static units have no time, units without their source
+// are always used
+bool QmcLoader::isUpToDate(const QString &file)
+{
+    if (file.startsWith(':'))
+        return true;
+    const QFileInfo source(sourceFile(file));
+    if (!source.exists())
+        return true;
+    const QFileInfo precompiled(file);
+    return precompiled.exists() && precompiled.lastModified() >= source.lastModified();
+}
+
+QByteArray QmcLoader::moduleFingerprint(const QString &uri, int majorVersion)
+{
+    Q_D(QmcLoader);
+    // modules register their types when first imported, a module is taken
+    // as unchanged while its highest minor version stays the same
+    QQmlTypeModule *module = QQmlMetaType::typeModule(uri, majorVersion);
+    const QString key = uri + ' ' + QString::number(majorVersion) + '.'
+            + QString::number(module ? module->maximumMinorVersion() : -1);
+    QHash<QString, QByteArray>::const_iterator it = d->moduleFingerprints.constFind(key);
+    if (it == d->moduleFingerprints.constEnd())
+        it = d->moduleFingerprints.insert(key, QmcModuleFingerprint::importData(uri, majorVersion));
+    return it.value();
+}
+
+void QmcLoader::useJit(QQmlEngine *engine)
+{
+    // sources compiled for units have to use the JIT as their code does,
+    // an engine already using it is left as it is
+    QV4::ExecutionEngine *v4 = QQmlEnginePrivate::get(engine)->v4engine();
+    if (!dynamic_cast<QV4::JIT::ISelFactory *>(v4->iselFactory.data()))
+        v4->iselFactory.reset(new QV4::JIT::ISelFactory);
+}
+
+void QmcLoader::setSourceFallbackEnabled(bool enabled)
+{
+    Q_D(QmcLoader);
+    d->sourceFallback = enabled;
+}
+
+bool QmcLoader::isSourceFallbackEnabled() const
+{
+    const Q_D(QmcLoader);
+    return d->sourceFallback;
+}
+
+void QmcLoader::registerStaticUnit(const QString &file, const uchar *data, qint64 size)
+{
+    QmcUnitCache::addStaticUnit(file, data, size);
+}
+
 QString QmcLoader::getBaseUrl(const QUrl &url)
 {
     QString path = url.path();
@@ -239,45 +669,48 @@ bool QmcLoader::loadDependency(QDataStream &stream, const QUrl &loadedUrl)
 {
     clearError();
     QmcUnit *unit = doloadDependency(stream, loadedUrl);
+    if (!unit)
+        return false;
     unit->blob->release();
     return true;
 }
 
-bool QmcLoader::loadDependency(const QString &file)
+bool QmcLoader::loadDependency(const uchar *data, qint64 size, const QUrl &loadedUrl)
 {
     clearError();
-    QFile f(file);
-    if (!f.open(QFile::ReadOnly)) {
+    Q_D(QmcLoader);
+    QmcUnit *unit = QmcUnit::loadUnit(data, size, d->engine, this, loadedUrl);
+    if (!unit) {
         QQmlError error;
-        error.setDescription("Could not open file for reading");
+        error.setDescription("Error loading");
         appendError(error);
-        return NULL;
+        return false;
     }
+    addDependency(unit);
+    unit->blob->release();
+    return true;
+}
 
-    QDataStream in(&f);
-    QmcUnit *unit = doloadDependency(in, createLoadedUrl(file));
+bool QmcLoader::loadDependency(const QString &file)
+{
+    clearError();
+    QmcUnit *unit = loadUnit(file);
+    if (!unit)
+        return false;
+    addDependency(unit);
     unit->blob->release();
-    f.close();
     return true;
 }
 
 QmcUnit *QmcLoader::doloadDependency(const QString &url)
 {
-    QUrl u(url);
-    QString file = u.toLocalFile();
-    QFile f(file);
-    if (!f.open(QFile::ReadOnly)) {
-        QQmlError error;
-        error.setDescription("Could not open file for reading: " + f.errorString());
-        error.setUrl(QUrl(file));
-        qDebug() << "Cannot open" << file;
-        appendError(error);
+    QString file = fileForUrl(QUrl(url));
+    QmcUnit *unit = loadUnit(file);
+    if (!unit) {
+        qDebug() << "Cannot load" << file;
         return NULL;
     }
-
-    QDataStream in(&f);
-    QmcUnit *unit = doloadDependency(in, createLoadedUrl(file));
-    f.close();
+    addDependency(unit);
     return unit;
 }
 
@@ -291,11 +724,16 @@ QmcUnit *QmcLoader::doloadDependency(QDataStream &stream, const QUrl &loadedUrl)
         appendError(error);
         return NULL;
     }
+    addDependency(unit);
+    return unit;
+}
 
+void QmcLoader::addDependency(QmcUnit *unit)
+{
+    Q_D(QmcLoader);
     // add to dependencies
     d->dependencies[unit->loadedUrl.toString()] = unit;
     unit->blob->addref();
-    return unit;
 }
 
 const QList<QQmlError>& QmcLoader::errors() const
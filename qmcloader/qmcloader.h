@@ -32,6 +32,8 @@ class QQmlComponent;
 class QmcLoaderPrivate;
 class QmcUnit;
 class QmcScriptUnit;
+class QmcPackage;
+struct QmcLoadRequest;
 
 
 class QMCLOADERSHARED_EXPORT QmcLoader : public QObject
@@ -42,24 +44,77 @@ public:
     explicit QmcLoader(QQmlEngine *engine, QObject *parent = 0);
     QQmlComponent *loadComponent(QDataStream &stream, const QUrl &loadedUrl);
     QQmlComponent *loadComponent(const QString &file);
+    // the unit is used in place from the buffer without copying, the buffer
+    // must stay valid and unchanged as long as the engine uses the unit
+    QQmlComponent *loadComponent(const uchar *data, qint64 size, const QUrl &loadedUrl);
+    // loads the precompiled file next to the source if it is up to date,
+    // otherwise the engine compiles the source
+    QQmlComponent *loadSource(const QUrl &source);
+    // reads and parses the file in a worker thread, the unit is linked and
+    // the component is created in the thread of the loader, componentLoaded
+    // is emitted when done
+    void loadComponentAsync(const QString &file);
     bool loadDependency(QDataStream &stream, const QUrl &loadedUrl);
     bool loadDependency(const QString &file);
+    bool loadDependency(const uchar *data, qint64 size, const QUrl &loadedUrl);
+    // units in the package are loaded from it instead of separate files,
+    // the package is mapped if file mapping is enabled
+    bool addPackage(const QString &file);
     const QList<QQmlError>& errors() const;
     QmcScriptUnit *getScript(const QString &url, const QUrl &loaderUrl);
     QmcUnit *getType(const QString &name, const QUrl &loaderUrl);
     void setLoadDependenciesAutomatically(bool load);
     bool isLoadDependenciesAutomatically() const;
+    void setFileMappingEnabled(bool enabled);
+    bool isFileMappingEnabled() const;
+    // functions of inline components and imported scripts are linked on
+    // their first call instead of when the unit is loaded
+    void setLazyLinkingEnabled(bool enabled);
+    bool isLazyLinkingEnabled() const;
+    // types and scripts without an up to date precompiled file are compiled
+    // from their source by the engine instead of failing the unit
+    void setSourceFallbackEnabled(bool enabled);
+    bool isSourceFallbackEnabled() const;
+    // fingerprint data of an imported module, computed once per loader for
+    // each module version, see QmcModuleFingerprint
+    QByteArray moduleFingerprint(const QString &uri, int majorVersion);
     static QString getBaseUrl(const QUrl &url);
+    // url of a source for the engine, url is relative to loaded units
+    static QUrl sourceUrl(const QString &url);
+    // switches the engine to the JIT before it compiles sources for units
+    static void useJit(QQmlEngine *engine);
+    // unit compiled into the binary with qmc --emit-cpp, loading the file
+    // name uses the data in place without any file access, the data must
+    // stay valid for the rest of the process
+    static void registerStaticUnit(const QString &file, const uchar *data, qint64 size);
+
+signals:
+    // component is NULL if loading failed, errors() has the errors then
+    void componentLoaded(const QString &file, QQmlComponent *component);
+
+private slots:
+    void asyncLoadFinished();
 
 private:
-    QUrl createLoadedUrl(const QString &url);
+    static QUrl createLoadedUrl(const QString &url);
+    static QString fileForUrl(const QUrl &url);
+    static QString sourceFile(const QString &file);
+    static bool isUpToDate(const QString &file);
+    static QmcLoadRequest readUnit(QmcLoadRequest request);
+    static void readDependencies(QmcLoadRequest &request);
+    static void prefetch(const QList<QmcPackage *> &packages, const QString &file);
+    QmcUnit *loadUnit(const QString &file);
+    QmcUnit *attachUnit(QmcUnit *unit, const QString &file);
+    void attachDependencies(const QList<QmcUnit *> &units);
+    QQmlComponent *createComponent(QmcUnit *unit);
     QmcUnit *doloadDependency(const QString &url);
     QmcUnit *doloadDependency(QDataStream &stream, const QUrl &loadedUrl);
+    void addDependency(QmcUnit *unit);
     void appendError(QQmlError error);
     void appendErrors(const QList<QQmlError>& errors);
     void clearError();
     QmcUnit *getUnit(const QString &url);
-    QString precompiledUrl(const QString &url);
+    static QString precompiledUrl(const QString &url);
 };
 
 #endif // QMCLOADER_H
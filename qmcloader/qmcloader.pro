@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += qml qml-private core-private
+QT       += qml qml-private core-private concurrent
 QT       -= gui
 
 TARGET = qmcloader
@@ -30,19 +30,24 @@ SOURCES += qmcloader.cpp \
     qmcunitpropertycachecreator.cpp \
     qmctypeunit.cpp \
     qmcscriptunit.cpp \
-    qmctypeunitcomponentandaliasresolver.cpp \
-    qmcbackedinstructionselection.cpp
+    qmcpackage.cpp \
+    qmcunitcache.cpp \
+    qmccompilationunit.cpp \
+    qmctypeunitcomponentandaliasresolver.cpp
 
 
 HEADERS += qmcloader.h \
     qmcloader_global.h \
     compiler.h \
     qmcunit.h \
+    qmcunitreader.h \
     qmcunitpropertycachecreator.h \
     qmctypeunit.h \
     qmcscriptunit.h \
-    qmctypeunitcomponentandaliasresolver.h \
-    qmcbackedinstructionselection.h
+    qmcpackage.h \
+    qmcunitcache.h \
+    qmccompilationunit.h \
+    qmctypeunitcomponentandaliasresolver.h
 
 unix {
     target.path = /usr/lib
@@ -0,0 +1,239 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#include <QDir>
+#include <QFileInfo>
+
+#include "qmcpackage.h"
+#include "qmcunitcache.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+QmcPackagePool::QmcPackagePool(const QByteArray &data, const QSharedPointer<QFile> &file)
+    : data(data),
+      file(file),
+      stringOffsets(NULL),
+      stringData(NULL),
+      stringCount(0),
+      constantData(NULL),
+      constantCount(0)
+{
+}
+
+bool QmcPackagePool::read(const QmcPackagePoolHeader &header)
+{
+    const quint64 size = data.size();
+    if (header.stringsOffset > size || quint64(header.strings) + 1 > (size - header.stringsOffset) / sizeof (quint32))
+        return false;
+    stringOffsets = data.constData() + header.stringsOffset;
+    stringData = stringOffsets + (quint64(header.strings) + 1) * sizeof (quint32);
+    stringCount = header.strings;
+
+    // offsets are ascending and the last one is the end of the data
+    const quint64 stringDataSize = size - (stringData - data.constData());
+    quint32 previous = 0;
+    for (quint32 i = 0; i <= stringCount; i++) {
+        quint32 offset;
+        memcpy(&offset, stringOffsets + i * sizeof (quint32), sizeof (offset));
+        if (offset < previous || offset > stringDataSize)
+            return false;
+        previous = offset;
+    }
+
+    if (header.constantsOffset > size || header.constants > (size - header.constantsOffset) / sizeof (QV4::Primitive))
+        return false;
+    constantData = data.constData() + header.constantsOffset;
+    constantCount = header.constants;
+    return true;
+}
+
+bool QmcPackagePool::string(quint32 index, QString *string)
+{
+    if (index >= stringCount)
+        return false;
+    QMutexLocker locker(&mutex);
+    QHash<quint32, QString>::const_iterator it = strings.constFind(index);
+    if (it == strings.constEnd()) {
+        quint32 offsets[2];
+        memcpy(offsets, stringOffsets + index * sizeof (quint32), sizeof (offsets));
+        it = strings.insert(index, QString::fromUtf8(stringData + offsets[0], offsets[1] - offsets[0]));
+    }
+    *string = it.value();
+    return true;
+}
+
+bool QmcPackagePool::constants(quint32 index, quint32 count, QVector<QV4::Primitive> *constants)
+{
+    if (index > constantCount || count > constantCount - index)
+        return false;
+    QMutexLocker locker(&mutex);
+    const quint64 key = (quint64(count) << 32) | index;
+    QHash<quint64, QVector<QV4::Primitive> >::const_iterator it = constantTables.constFind(key);
+    if (it == constantTables.constEnd()) {
+        QVector<QV4::Primitive> table(count);
+        memcpy(table.data(), constantData + quint64(index) * sizeof (QV4::Primitive), count * sizeof (QV4::Primitive));
+        it = constantTables.insert(key, table);
+    }
+    *constants = it.value();
+    return true;
+}
+
+QmcPackage::QmcPackage()
+    : borrowed(false)
+{
+}
+
+QmcPackage::~QmcPackage()
+{
+    // units keep the file mapped as long as they need it
+    data.clear();
+}
+
+QmcPackage *QmcPackage::open(const QString &file, bool mapping)
+{
+    QmcPackage *package = new QmcPackage;
+    package->dir = QDir::cleanPath(QFileInfo(file).absolutePath());
+    // uncompressed resources are used in place, compressed ones are read
+    // as mapping would give the compressed data
+    package->borrowed = QmcUnitCache::resourceData(file, &package->data);
+    if (!package->borrowed) {
+        QSharedPointer<QFile> f(new QFile(file));
+        if (!f->open(QFile::ReadOnly)) {
+            delete package;
+            return NULL;
+        }
+        const bool resource = file.startsWith(QLatin1Char(':'));
+        uchar *mapped = mapping && !resource && f->size() > 0 ? f->map(0, f->size()) : NULL;
+        if (mapped) {
+            package->data = QByteArray::fromRawData((const char *)mapped, f->size());
+            package->file = f;
+            package->borrowed = true;
+        } else
+            package->data = f->readAll();
+    }
+
+    if (!package->readIndex()) {
+        delete package;
+        return NULL;
+    }
+    return package;
+}
+
+bool QmcPackage::readIndex()
+{
+    QmcUnitReader reader(data.constData(), data.size());
+    reader.setAligned(true);
+    QmcPackageHeader header;
+    if (!reader.read(header))
+        return false;
+    if (strncmp(header.magic, QMC_PACKAGE_MAGIC_STR, sizeof (header.magic))
+            || header.version < QMC_PACKAGE_MIN_VERSION || header.version > QMC_PACKAGE_VERSION)
+        return false;
+    if (header.version >= 2) {
+        QmcPackagePoolHeader poolHeader;
+        if (!reader.read(poolHeader))
+            return false;
+        sharedPool = QSharedPointer<QmcPackagePool>(new QmcPackagePool(data, file));
+        if (!sharedPool->read(poolHeader))
+            return false;
+    }
+    if (!entries.read(reader, header.entries))
+        return false;
+
+    // names and units must be inside the package and names sorted for lookup
+    const quint64 size = data.size();
+    for (int i = 0; i < entries.size(); i++) {
+        const QmcPackageEntry &entry = entries[i];
+        if (entry.nameOffset > size || entry.nameLength > size - entry.nameOffset)
+            return false;
+        if (entry.offset > size || entry.size > size - entry.offset)
+            return false;
+        if (entry.offset % QMC_PACKAGE_UNIT_ALIGNMENT)
+            return false;
+        if (i > 0 && !(name(i - 1) < name(i)))
+            return false;
+    }
+    return true;
+}
+
+QByteArray QmcPackage::name(int entry) const
+{
+    const QmcPackageEntry &e = entries[entry];
+    return QByteArray::fromRawData(data.constData() + e.nameOffset, e.nameLength);
+}
+
+int QmcPackage::find(const QString &file) const
+{
+    const QString path = QDir::cleanPath(QFileInfo(file).absoluteFilePath());
+    if (!path.startsWith(dir + '/'))
+        return -1;
+    const QByteArray key = path.mid(dir.length() + 1).toUtf8();
+
+    // binary search over the sorted names
+    int low = 0;
+    int high = entries.size();
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        const QByteArray n = name(mid);
+        if (n < key)
+            low = mid + 1;
+        else if (key < n)
+            high = mid;
+        else
+            return mid;
+    }
+    return -1;
+}
+
+QByteArray QmcPackage::unitData(int entry) const
+{
+    const QmcPackageEntry &e = entries[entry];
+    // data read to memory is released with the package, units copy theirs
+    if (borrowed)
+        return QByteArray::fromRawData(data.constData() + e.offset, e.size);
+    return data.mid(e.offset, e.size);
+}
+
+QSharedPointer<QmcUnitData> QmcPackage::fileData(int entry) const
+{
+    // checksums, decompressed sections and shared code of the entry are
+    // kept with its file data like for separate files
+    QMutexLocker locker(&mutex);
+    QSharedPointer<QmcUnitData> data = fileDatas.value(entry).toStrongRef();
+    if (!data) {
+        data = QSharedPointer<QmcUnitData>(new QmcUnitData(unitData(entry), file, unitOffset(entry), sharedPool));
+        fileDatas.insert(entry, data);
+    }
+    return data;
+}
+
+void QmcPackage::prefetch(int entry) const
+{
+    // packages read to memory have nothing to fetch
+    if (!file)
+        return;
+    const QmcPackageEntry &e = entries[entry];
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize <= 0 || e.size == 0)
+        return;
+    const quintptr start = quintptr(data.constData() + e.offset);
+    const quintptr pageStart = start & ~quintptr(pageSize - 1);
+    madvise((void *)pageStart, e.size + (start - pageStart), MADV_WILLNEED);
+}
@@ -0,0 +1,113 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#ifndef QMCPACKAGE_H
+#define QMCPACKAGE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+#include <private/qv4value_p.h>
+
+#include "qmcfile.h"
+#include "qmcunitreader.h"
+
+struct QmcUnitData;
+
+// strings and constant tables shared by the units of a package, each entry
+// is created once when first used and then shared by all units using it
+class QmcPackagePool
+{
+public:
+    QmcPackagePool(const QByteArray &data, const QSharedPointer<QFile> &file);
+
+    // validates the pool inside data
+    bool read(const QmcPackagePoolHeader &header);
+    // false if index is out of range, can be called from any thread
+    bool string(quint32 index, QString *string);
+    bool constants(quint32 index, quint32 count, QVector<QV4::Primitive> *constants);
+
+private:
+    // package data, mapping is kept while units refer to the pool
+    const QByteArray data;
+    const QSharedPointer<QFile> file;
+    // read with memcpy, the pool of a package read to memory may be unaligned
+    const char *stringOffsets;
+    const char *stringData;
+    quint32 stringCount;
+    const char *constantData;
+    quint32 constantCount;
+
+    QMutex mutex;
+    QHash<quint32, QString> strings;
+    QHash<quint64, QVector<QV4::Primitive> > constantTables; // by count and index
+};
+
+// index of a package of compiled units, the package is mapped or read
+// once and the units are loaded from it in place
+class QmcPackage
+{
+public:
+    ~QmcPackage();
+
+    // returns NULL if the file cannot be read or is not a valid package
+    static QmcPackage *open(const QString &file, bool mapping);
+
+    // directory of the package, entry names are relative to it
+    const QString &path() const { return dir; }
+
+    // index of the entry for file path, -1 if not in the package
+    int find(const QString &file) const;
+
+    // unit data of entry, refers to the package data in place unless it
+    // was read to memory
+    QByteArray unitData(int entry) const;
+    // file data of entry, shared by all units read from it while any of
+    // them exists, can be called from any thread
+    QSharedPointer<QmcUnitData> fileData(int entry) const;
+    // offset of unit data in the mapped file
+    qint64 unitOffset(int entry) const { return entries[entry].offset; }
+    // mapped package file, NULL if the package was read to memory
+    const QSharedPointer<QFile> &mappedFile() const { return file; }
+    // starts reading the pages of a mapped entry ahead of use
+    void prefetch(int entry) const;
+    // pool referred to by units compiled with QMC_UNIT_FLAG_SHARED_POOL
+    const QSharedPointer<QmcPackagePool> &pool() const { return sharedPool; }
+
+private:
+    QmcPackage();
+    bool readIndex();
+    QByteArray name(int entry) const;
+
+    QString dir;
+    QSharedPointer<QFile> file;
+    QByteArray data;
+    bool borrowed; // data is a resource or mapping the package does not own
+    QmcUnitTable<QmcPackageEntry> entries;
+    QSharedPointer<QmcPackagePool> sharedPool;
+
+    mutable QMutex mutex; // guards fileDatas
+    mutable QHash<int, QWeakPointer<QmcUnitData> > fileDatas; // by entry
+};
+
+#endif // QMCPACKAGE_H
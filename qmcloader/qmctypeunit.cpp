@@ -31,6 +31,7 @@
 #include "qmcloader.h"
 #include "qmcscriptunit.h"
 #include "qmctypeunitcomponentandaliasresolver.h"
+#include "qmcmodulefingerprint.h"
 
 QmcTypeUnit::QmcTypeUnit(QmcUnit *qmcUnit, QQmlTypeLoader *typeLoader)
     : Blob(qmcUnit->url, QQmlDataBlob::QmlFile, typeLoader),
@@ -66,6 +67,8 @@ QmcUnit *QmcTypeUnit::qmcUnit()
 
 void QmcTypeUnit::initializeFromCachedUnit(const QQmlPrivate::CachedQmlUnit *)
 {
+    // never created by the type loader, units in the binary are registered
+    // with QmcLoader::registerStaticUnit instead
 }
 
 void QmcTypeUnit::dataReceived(const Data &)
@@ -120,11 +123,16 @@ bool QmcTypeUnit::addImports()
 
     // qqmltypeloader.cpp:2271
     // ->addImport qqmltypeloader.cpp:1311
+    // fingerprint is needed only to use the resolutions of the compiler
+    const bool fingerprinted = !unit->typeResolutions.isEmpty();
+    QmcModuleFingerprint fingerprint;
     for (uint i = 0; i < compiledData->qmlUnit->nImports; i++) {
         const QV4::CompiledData::Import *p = compiledData->qmlUnit->importAt(i);
         if (p->type == QV4::CompiledData::Import::ImportScript) {
             // load it if it does not exist yet
-            QmcScriptUnit* scriptUnit = unit->loader->getScript(stringAt(p->uriIndex), unit->loadedUrl);
+            QQmlScriptBlob *scriptUnit = unit->loader->getScript(stringAt(p->uriIndex), unit->loadedUrl);
+            if (!scriptUnit)
+                scriptUnit = sourceScript(QmcLoader::sourceUrl(QmcLoader::getBaseUrl(unit->loadedUrl) + stringAt(p->uriIndex)));
             if (!scriptUnit) {
                 QQmlError error;
                 error.setColumn(p->location.column);
@@ -142,6 +150,8 @@ bool QmcTypeUnit::addImports()
         } else if (p->type == QV4::CompiledData::Import::ImportLibrary) {
             if (!addImport(p, &unit->errors))
                 return false;
+            if (fingerprinted)
+                fingerprint.addImportData(unit->loader->moduleFingerprint(stringAt(p->uriIndex), p->majorVersion));
         } else if (p->type == QV4::CompiledData::Import::ImportFile) {
             // load file import
             // qqmltypeloader.cpp:1384
@@ -187,24 +197,29 @@ bool QmcTypeUnit::addImports()
     // qqmltypeloader.cpp:2402 QV4::CompiledData::TypeReference -> QQmlTypeData::TypeReference
     // qqmltypecompiler.cpp:86 QQmlTypeData::TypeReference -> QQmlCompiledData::TypeReference
 
+    // resolutions of the compiler are valid while the modules are the same
+    const bool resolved = fingerprinted && fingerprint.value() == unit->moduleFingerprint;
     foreach (const QmcUnitTypeReference& typeRef, unit->typeReferences) {
         int majorVersion = -1;
         int minorVersion = -1;
         QQmlImportNamespace *typeNamespace = 0;
-        if ((int)typeRef.index >= unit->strings.size())
+        if (typeRef.index >= unit->header->strings)
             return false;
         const QString name = stringAt(typeRef.index);
         if (typeRef.syntheticComponent)
             continue;
         QQmlCompiledData::TypeReference *ref = new QQmlCompiledData::TypeReference;
         QQmlType *qmlType = NULL;
-        if (!m_importCache.resolveType(name, &qmlType, &majorVersion, &minorVersion, &typeNamespace, &unit->errors)) {
+        const bool found = resolved && resolveTypeReference(typeRef.index, ref, &qmlType, &majorVersion, &minorVersion);
+        if (!found && !m_importCache.resolveType(name, &qmlType, &majorVersion, &minorVersion, &typeNamespace, &unit->errors)) {
             // try to load it as implicit import
             QmcUnit *typeUnit = qmcUnit()->loader->getType(name, finalUrl());
             if (typeUnit) {
                 ref->component = ((QmcTypeUnit *)typeUnit->blob)->refCompiledData(); // addref
                 unit->errors.clear();
                 dependencies.append(typeUnit);
+            } else if (sourceTypeReference(QmcLoader::sourceUrl(QmcLoader::getBaseUrl(unit->loadedUrl) + name + ".qml"), ref)) {
+                unit->errors.clear();
             } else {
                 QQmlError error;
                 error.setDescription("Could not load implicit import");
@@ -233,7 +248,7 @@ bool QmcTypeUnit::addImports()
             if (typeUnit) {
                 ref->component = ((QmcTypeUnit *)typeUnit->blob)->refCompiledData(); // addref
                 dependencies.append(typeUnit);
-            } else {
+            } else if (!sourceTypeReference(qmlType->sourceUrl(), ref)) {
                 QQmlError error;
                 error.setDescription("Could not load implicit import");
                 unit->errors.append(error);
@@ -300,7 +315,9 @@ bool QmcTypeUnit::addImports()
         if (!sourceNameForUrl(scriptRef.location, locationName))
             return false;
 
-        QmcScriptUnit *script = unit->loader->getScript(locationName, unit->loadedUrl);
+        QQmlScriptBlob *script = unit->loader->getScript(locationName, unit->loadedUrl);
+        if (!script)
+            script = sourceScript(scriptRef.location);
         if (!script) {
             QQmlError error;
             error.setDescription("Could not load script");
@@ -318,6 +335,65 @@ bool QmcTypeUnit::addImports()
     return true;
 }
 
+bool QmcTypeUnit::resolveTypeReference(int index, QQmlCompiledData::TypeReference *ref, QQmlType **qmlType, int *majorVersion, int *minorVersion)
+{
+    QHash<int, QmcUnitTypeResolution>::const_iterator resolution = unit->typeResolutions.constFind(index);
+    if (resolution == unit->typeResolutions.constEnd())
+        return false;
+
+    // types that cannot be found any more are resolved by name
+    switch (resolution->kind) {
+    case QMC_TYPE_RESOLUTION_TYPE:
+        *qmlType = QQmlMetaType::qmlType(resolution->name, resolution->majorVersion, resolution->minorVersion);
+        if (!*qmlType)
+            return false;
+        break;
+    case QMC_TYPE_RESOLUTION_COMPOSITE: {
+        QmcUnit *typeUnit = unit->loader->getType(resolution->name, unit->loadedUrl);
+        if (!typeUnit)
+            return false;
+        ref->component = ((QmcTypeUnit *)typeUnit->blob)->refCompiledData(); // addref
+        dependencies.append(typeUnit);
+        break;
+    }
+    default:
+        return false;
+    }
+    *majorVersion = resolution->majorVersion;
+    *minorVersion = resolution->minorVersion;
+    return true;
+}
+
+bool QmcTypeUnit::sourceTypeReference(const QUrl &source, QQmlCompiledData::TypeReference *ref)
+{
+    if (!unit->loader->isSourceFallbackEnabled() || source.isEmpty())
+        return false;
+    QmcLoader::useJit(unit->engine);
+    QQmlTypeData *typeData = typeLoader()->getType(source);
+    if (typeData->isComplete()) {
+        ref->component = typeData->compiledData();
+        ref->component->addref();
+    } else
+        unit->errors.append(typeData->errors());
+    typeData->release();
+    return ref->component != NULL;
+}
+
+QQmlScriptBlob *QmcTypeUnit::sourceScript(const QUrl &source)
+{
+    if (!unit->loader->isSourceFallbackEnabled() || source.isEmpty())
+        return NULL;
+    QmcLoader::useJit(unit->engine);
+    QQmlScriptBlob *script = typeLoader()->getScript(source);
+    if (!script->isComplete()) {
+        unit->errors.append(script->errors());
+        script->release();
+        return NULL;
+    }
+    sourceScripts.insert(script);
+    return script;
+}
+
 bool QmcTypeUnit::sourceNameForUrl(const QUrl &url, QString &name)
 {
     name = url.toString();
@@ -354,6 +430,8 @@ QQmlCompiledData *QmcTypeUnit::refCompiledData()
 bool QmcTypeUnit::initDependencies()
 {
     foreach (const QQmlTypeData::ScriptReference &scriptRef, scripts) {
+        if (sourceScripts.contains(scriptRef.script))
+            continue;
         QmcScriptUnit *script = (QmcScriptUnit *)scriptRef.script;
         if (!script->initialize())
             return false;
@@ -20,7 +20,10 @@
 #ifndef QMCTYPEUNIT_H
 #define QMCTYPEUNIT_H
 
+#include <QSet>
+
 #include <private/qqmltypeloader_p.h>
+#include <private/qqmlcompiler_p.h>
 
 class QmcUnit;
 class QmcUnitPropertyCacheCreator;
@@ -48,6 +51,10 @@ private:
     bool initDependencies();
     bool initQml();
     bool sourceNameForUrl(const QUrl &url, QString &name);
+    // compiled from source by the engine with source fallback enabled
+    bool sourceTypeReference(const QUrl &source, QQmlCompiledData::TypeReference *ref);
+    QQmlScriptBlob *sourceScript(const QUrl &source);
+    bool resolveTypeReference(int index, QQmlCompiledData::TypeReference *ref, QQmlType **qmlType, int *majorVersion, int *minorVersion);
 
     QmcUnit *unit;
 
@@ -59,6 +66,7 @@ private:
     //QList<QQmlTypeData::TypeReference> compositeSingletons;
     bool doneLinking;
     QList<QQmlTypeData::ScriptReference> scripts;
+    QSet<QQmlScriptBlob *> sourceScripts; // in scripts, not precompiled
     QList<QmcUnit *> dependencies;
     friend class QmcUnitPropertyCacheCreator;
     friend class QmcTypeUnitComponentAndAliasResolver;
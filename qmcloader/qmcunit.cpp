@@ -19,8 +19,12 @@
 
 #include "qmcunit.h"
 
+#include <QResource>
+
 #include <sys/mman.h>
 #include <sys/user.h>
+#include <unistd.h>
+#include <limits.h>
 
 #include <private/qv4assembler_p.h>
 #include <private/qv4executableallocator_p.h>
@@ -30,10 +34,13 @@
 #include "qmcunitpropertycachecreator.h"
 #include "qmctypeunit.h"
 #include "qmcscriptunit.h"
+#include "qmcloader.h"
 
 #include "qmclinktable.h"
-
-#include "qmcbackedinstructionselection.h"
+#include "qmcrelocation.h"
+#include "qmcpackage.h"
+#include "qmccompression.h"
+#include "qmcchecksum.h"
 
 QT_USE_NAMESPACE
 
@@ -44,48 +51,162 @@ QmcUnit::QmcUnit(QmcUnitHeader *header, const QUrl& url, const QString &urlStrin
     header(header),
     qmlUnit(NULL),
     unit(NULL),
-    compilationUnit(new QV4::JIT::CompilationUnit),
+    compilationUnit(new QmcCompilationUnit),
     url(url),
     urlString(urlString),
     loadedUrl(loadedUrl),
     type((QmcFileType)header->type),
     loader(loader),
-    name(name)
+    blob(NULL),
+    name(name),
+    moduleFingerprint(0),
+    checksumType(QMC_UNIT_CHECKSUM_NONE),
+    codeSection(NULL),
+    codeSectionSize(0),
+    codeSectionCompressedSize(0),
+    codeMapping(NULL),
+    codeMappingSize(0)
 {
     compilationUnit->ref();
-    QQmlTypeLoader *typeLoader = &QQmlEnginePrivate::get(engine)->typeLoader;
-    if (type == QMC_QML)
-        blob = new QmcTypeUnit(this, typeLoader);
-    else
-        blob = new QmcScriptUnit(this, typeLoader);
 }
 
 QmcUnit::~QmcUnit()
 {
     delete header;
-    delete qmlUnit;
     compilationUnit->deref();
-    for (int i = 0; i < allocations.size(); i++) {
-        QV4::ExecutableAllocator::Allocation *a = allocations[i];
-        a->deallocate(QQmlEnginePrivate::get(engine)->v4engine()->executableAllocator);
-    }
-    allocations.clear();
+    // code mapping is left only if linking failed
+    if (codeMapping)
+        munmap(codeMapping, codeMappingSize);
+    // unmaps the data unless other units or compilation units use it
+    fileData.clear();
 }
 
 QmcUnit *QmcUnit::loadUnit(QDataStream &stream, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl)
+{
+    return attach(readUnit(stream, engine, loader, loadedUrl));
+}
+
+QmcUnit *QmcUnit::loadUnit(QFile *file, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl)
+{
+    return attach(readUnit(file, engine, loader, loadedUrl));
+}
+
+QmcUnit *QmcUnit::loadUnit(const QmcPackage *package, int entry, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl)
+{
+    return attach(readUnit(package, entry, engine, loader, loadedUrl));
+}
+
+QmcUnit *QmcUnit::loadUnit(const uchar *data, qint64 size, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl)
+{
+    return attach(readUnit(data, size, engine, loader, loadedUrl));
+}
+
+QmcUnit *QmcUnit::attach(QmcUnit *unit)
+{
+    if (!unit)
+        return NULL;
+    Q_ASSERT(!unit->blob);
+    // blob owns the unit from here on
+    QQmlTypeLoader *typeLoader = &QQmlEnginePrivate::get(unit->engine)->typeLoader;
+    if (unit->type == QMC_QML)
+        unit->blob = new QmcTypeUnit(unit, typeLoader);
+    else
+        unit->blob = new QmcScriptUnit(unit, typeLoader);
+    if (!unit->linkCodeRefs()) {
+        unit->blob->release();
+        return NULL;
+    }
+    return unit;
+}
+
+QmcUnit *QmcUnit::readUnit(QDataStream &stream, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl)
+{
+    QIODevice *device = stream.device();
+    if (!device)
+        return NULL;
+
+    // read rest of the stream in one go, unit data is used in place from the buffer
+    qint64 start = device->pos();
+    QByteArray data = device->readAll();
+    qint64 consumed = 0;
+    QSharedPointer<QmcUnitData> fileData(new QmcUnitData(data, QSharedPointer<QFile>(), 0));
+    QmcUnit *unit = readUnit(fileData, engine, loader, loadedUrl, &consumed);
+    if (unit && !device->isSequential())
+        device->seek(start + consumed);
+    return unit;
+}
+
+QmcUnit *QmcUnit::readUnit(QFile *file, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl)
+{
+    QByteArray data;
+    QSharedPointer<QFile> mappedFile(file);
+    // mapping a compressed resource gives the compressed data
+    const bool compressed = file->fileName().startsWith(QLatin1Char(':')) && QResource(file->fileName()).isCompressed();
+    uchar *mapped = !compressed && file->size() > 0 ? file->map(0, file->size()) : NULL;
+    if (mapped) {
+        data = QByteArray::fromRawData((const char *)mapped, file->size());
+    } else {
+        // mapping not supported, fall back to reading
+        data = file->readAll();
+        mappedFile.clear();
+    }
+    return readUnit(QSharedPointer<QmcUnitData>(new QmcUnitData(data, mappedFile, 0)), engine, loader, loadedUrl, NULL);
+}
+
+QmcUnit *QmcUnit::readUnit(const QmcPackage *package, int entry, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl)
+{
+    return readUnit(package->fileData(entry), engine, loader, loadedUrl, NULL);
+}
+
+QmcUnit *QmcUnit::readUnit(const uchar *data, qint64 size, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl)
+{
+    if (!data || size <= 0 || size > INT_MAX)
+        return NULL;
+    // borrowed, nothing is copied unless the buffer is not aligned
+    QByteArray bytes = QByteArray::fromRawData((const char *)data, int(size));
+    return readUnit(QSharedPointer<QmcUnitData>(new QmcUnitData(bytes, QSharedPointer<QFile>(), 0)), engine, loader, loadedUrl, NULL);
+}
+
+QmcUnit *QmcUnit::readUnit(const QSharedPointer<QmcUnitData> &fileData, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl)
+{
+    return readUnit(fileData, engine, loader, loadedUrl, NULL);
+}
+
+QmcUnit *QmcUnit::readUnit(const QSharedPointer<QmcUnitData> &fileData, QQmlEngine *engine, QmcLoader *loader,
+                           const QUrl &loadedUrl, qint64 *consumed)
 {
     //qDebug() << "Loading" << loadedUrl;
+    const QByteArray &data = fileData->data;
+    QmcUnitReader reader(data.constData(), data.size());
     QmcUnitHeader *header = new QmcUnitHeader;
 
-    bool ret = readData((char *)header, sizeof(QmcUnitHeader), stream);
-    if (!ret || !checkHeader(header)) {
+    bool ret = reader.read(*header);
+    if (!ret || !checkHeader(header, data.size())) {
+        delete header;
+        return NULL;
+    }
+    reader.setAligned(header->flags & QMC_UNIT_FLAG_ALIGNED);
+    // pooled units can only be loaded from their package
+    if ((header->flags & QMC_UNIT_FLAG_SHARED_POOL) && !fileData->pool) {
+        delete header;
+        return NULL;
+    }
+
+    // version 1 is read sequentially, version 2 by sections
+    QmcUnitTable<QmcUnitSection> sections;
+    quint32 checksumType = QMC_UNIT_CHECKSUM_NONE;
+    qint64 end = 0;
+    if (header->version >= 2 && !readSectionDirectory(sections, &checksumType, &end, reader, header)) {
         delete header;
         return NULL;
     }
 
     QString name;
     QString urlString;
-    if (!readString(name, stream) || !readString(urlString, stream)) {
+    QmcUnitReader namesSection(NULL, 0);
+    QmcUnitReader &namesReader = header->version >= 2 ? namesSection : reader;
+    if ((header->version >= 2 && !sectionReader(namesSection, sections, QMC_SECTION_NAMES, fileData.data(), header, checksumType, false))
+            || !readString(name, namesReader) || !readString(urlString, namesReader)) {
         delete header;
         return NULL;
     }
@@ -94,398 +215,790 @@ QmcUnit *QmcUnit::loadUnit(QDataStream &stream, QQmlEngine *engine, QmcLoader *l
     url.setUrl(urlString);
 
     QmcUnit *unit = new QmcUnit(header, url, urlString, engine, loader, name, loadedUrl);
+    unit->fileData = fileData;
+    unit->compilationUnit->setFileData(fileData);
+    unit->sections = sections;
+    unit->checksumType = checksumType;
+
+    bool loaded = true;
+    for (int id = QMC_SECTION_NAMES; id < QMC_SECTION_COUNT && loaded; id++) {
+        if (header->version >= 2) {
+            // code is checked and decompressed straight to executable memory
+            // when linking
+            QmcUnitReader r(NULL, 0);
+            loaded = sectionReader(r, sections, id, fileData.data(), header, checksumType, id == QMC_SECTION_CODE)
+                    && unit->loadSection(id, r);
+        } else
+            loaded = unit->loadSection(id, reader);
+    }
 
-    if (unit->loadUnitData(stream))
+    if (loaded) {
+        if (consumed)
+            *consumed = header->version >= 2 ? end : reader.position();
         return unit;
+    }
 
-    unit->blob->release();
+    delete unit;
     return NULL;
 }
 
-bool QmcUnit::loadUnitData(QDataStream &stream)
+bool QmcUnit::readSectionDirectory(QmcUnitTable<QmcUnitSection> &sections, quint32 *checksumType, qint64 *end, QmcUnitReader &reader,
+                                   const QmcUnitHeader *header)
 {
-    char *qmlUnitPtr = new char[header->sizeQmlUnit];
-    char *dataPtr = new char[header->sizeUnit];
-    qmlUnit = reinterpret_cast<QV4::CompiledData::QmlUnit*>(qmlUnitPtr);
-    unit = reinterpret_cast<QV4::CompiledData::Unit*>(dataPtr);
-    compilationUnit->data = unit;
-    if (!qmlUnit || !unit)
+    QmcUnitSectionDirectory directory;
+    if (!reader.read(directory))
         return false;
-
-    if (!readData(qmlUnitPtr, header->sizeQmlUnit, stream))
+    if (directory.checksumType != QMC_UNIT_CHECKSUM_NONE && directory.checksumType != QMC_UNIT_CHECKSUM_CRC32C)
         return false;
-
-    if (!readData(dataPtr, header->sizeUnit, stream))
+    *checksumType = directory.checksumType;
+    if (!sections.read(reader, directory.sections))
         return false;
 
-    // load imports
-    for (int i = 0; i < (int)header->imports; i++) {
-        QV4::CompiledData::Import import;
-        if (!readData((char *)&import, sizeof(QV4::CompiledData::Import), stream))
+    // sections must be inside the unit and known sections must not repeat
+    QBitArray found(QMC_SECTION_COUNT);
+    *end = reader.position();
+    foreach (const QmcUnitSection &section, sections) {
+        if (section.offset < quint64(reader.position()) || section.offset > quint64(reader.size())
+                || section.size > quint64(reader.size()) - section.offset)
+            return false;
+        if ((header->flags & QMC_UNIT_FLAG_ALIGNED) && section.offset % qmcUnitSectionAlignment(section.id, section.flags))
             return false;
-        if (import.uriIndex >= header->strings || import.qualifierIndex >= header->strings)
+        if ((section.flags & ~QMC_UNIT_SECTION_FLAG_COMPRESSED) || (section.flags && header->version < 3))
             return false;
-        imports.append(import);
+        if ((section.flags & QMC_UNIT_SECTION_FLAG_COMPRESSED) && section.size < sizeof (quint64))
+            return false;
+        if (section.id < QMC_SECTION_COUNT) {
+            if (found.testBit(section.id))
+                return false;
+            found.setBit(section.id);
+        }
+        *end = qMax<qint64>(*end, section.offset + section.size);
     }
+    return true;
+}
 
-    for (int i = 0; i < (int)header->strings; i++) {
-        QString string;
-        if (!readString(string, stream))
-            return false;
-        strings.append(string);
+const QmcUnitSection *QmcUnit::findSection(const QmcUnitTable<QmcUnitSection> &sections, int id)
+{
+    foreach (const QmcUnitSection &section, sections) {
+        if (section.id == id)
+            return &section;
     }
+    return NULL;
+}
 
-    for (int i = 0; i < (int)header->namespaces; i++) {
-        QString ns;
-        if (!readString(ns, stream))
+bool QmcUnit::sectionReader(QmcUnitReader &reader, const QmcUnitTable<QmcUnitSection> &sections, int id, QmcUnitData *fileData,
+                            const QmcUnitHeader *header, quint32 checksumType, bool code)
+{
+    // missing sections are empty
+    reader = QmcUnitReader(NULL, 0);
+    const QmcUnitSection *section = findSection(sections, id);
+    if (section) {
+        // checked and decompressed once for all units of the file
+        QMutexLocker locker(&fileData->mutex);
+        const char *sectionData = fileData->data.constData() + section->offset;
+        // checked when the section is read, unknown sections are never read
+        if (!code && !checkSection(section, fileData, checksumType))
             return false;
-        namespaces.append(ns);
+        reader = QmcUnitReader(sectionData, section->size);
+        // compressed section is decompressed to a buffer that lives as long
+        // as the file data, otherwise it is read as is
+        if ((section->flags & QMC_UNIT_SECTION_FLAG_COMPRESSED) && !code) {
+            QHash<int, QByteArray>::const_iterator buffer = fileData->sectionBuffers.constFind(id);
+            if (buffer == fileData->sectionBuffers.constEnd()) {
+                quint64 size;
+                memcpy(&size, sectionData, sizeof (size));
+                if (size > INT_MAX)
+                    return false;
+                QByteArray decompressed(size, Qt::Uninitialized);
+                if (!QmcCompression::decompress(sectionData + sizeof (size), section->size - sizeof (size), decompressed.data(), size))
+                    return false;
+                buffer = fileData->sectionBuffers.insert(id, decompressed);
+            }
+            reader = QmcUnitReader(buffer->constData(), buffer->size());
+        }
     }
+    reader.setAligned(header->flags & QMC_UNIT_FLAG_ALIGNED);
+    return true;
+}
 
-    for (int i = 0; i < (int)header->typeReferences; i++) {
-        QmcUnitTypeReference typeRef;
-        if (!readData((char *)&typeRef, sizeof (QmcUnitTypeReference), stream))
+bool QmcUnit::checkSection(const QmcUnitSection *section, QmcUnitData *fileData, quint32 checksumType)
+{
+    if (checksumType != QMC_UNIT_CHECKSUM_CRC32C || fileData->checkedSections.contains(section->id))
+        return true;
+    if (QmcChecksum::crc32c(fileData->data.constData() + section->offset, section->size) != section->checksum)
+        return false;
+    fileData->checkedSections.insert(section->id);
+    return true;
+}
+
+bool QmcUnit::checkCodeSection()
+{
+    const QmcUnitSection *section = findSection(sections, QMC_SECTION_CODE);
+    if (!section)
+        return true;
+    QMutexLocker locker(&fileData->mutex);
+    return checkSection(section, fileData.data(), checksumType);
+}
+
+bool QmcUnit::loadSection(int id, QmcUnitReader &reader)
+{
+    switch (id) {
+    case QMC_SECTION_NAMES:
+        // read already when creating the unit
+        break;
+    case QMC_SECTION_QML_UNIT: {
+        const char *qmlUnitData = reader.readInPlace(header->sizeQmlUnit, QMC_UNIT_DATA_ALIGNMENT);
+        if (!qmlUnitData)
             return false;
-        typeReferences.append(typeRef);
+        // units are used in place when aligned, otherwise copied
+        if (quintptr(qmlUnitData) % QMC_UNIT_DATA_ALIGNMENT) {
+            char *qmlUnitPtr = (char *)malloc(header->sizeQmlUnit);
+            if (!qmlUnitPtr)
+                return false;
+            memcpy(qmlUnitPtr, qmlUnitData, header->sizeQmlUnit);
+            qmlUnit = reinterpret_cast<QV4::CompiledData::QmlUnit*>(qmlUnitPtr);
+            compilationUnit->setQmlUnitCopy(qmlUnitPtr);
+        } else {
+            qmlUnit = reinterpret_cast<QV4::CompiledData::QmlUnit*>(const_cast<char *>(qmlUnitData));
+        }
+        break;
     }
-
-    // coderefs
-    codeRefSizes.resize(header->codeRefs);
-    for (int i = 0; i < (int)header->codeRefs; i++) {
-        quint32 codeRefLen = 0;
-        if (!readData((char *)&codeRefLen, sizeof(quint32), stream))
+    case QMC_SECTION_UNIT: {
+        const char *unitData = reader.readInPlace(header->sizeUnit, QMC_UNIT_DATA_ALIGNMENT);
+        if (!unitData)
             return false;
-        if (codeRefLen > QMC_UNIT_MAX_CODE_REF_SIZE)
+        // compilation unit frees its data unless it is static, older files
+        // do not mark the data static so they need to be copied
+        const QV4::CompiledData::Unit *fileUnit = reinterpret_cast<const QV4::CompiledData::Unit*>(unitData);
+        if (quintptr(unitData) % QMC_UNIT_DATA_ALIGNMENT || !(fileUnit->flags & QV4::CompiledData::Unit::StaticData)) {
+            char *dataPtr = (char *)malloc(header->sizeUnit);
+            if (!dataPtr)
+                return false;
+            memcpy(dataPtr, unitData, header->sizeUnit);
+            unit = reinterpret_cast<QV4::CompiledData::Unit*>(dataPtr);
+            unit->flags &= ~QV4::CompiledData::Unit::StaticData;
+        } else {
+            unit = const_cast<QV4::CompiledData::Unit*>(fileUnit);
+        }
+        if (unit->stringTableSize != header->strings)
             return false;
-        //qDebug() << "Codereflen" << QString("%1").arg(codeRefLen, 0, 16);
-        if (codeRefLen == 0) {
-            JSC::MacroAssemblerCodeRef codeRef;
-            compilationUnit->codeRefs.append(codeRef);
-            QVector<QmcUnitCodeRefLinkCall> linkData;
-            linkCalls.append(linkData);
-            QVector<QV4::Primitive> constData;
-            constantVectors.append(constData);
-            continue;
+        compilationUnit->data = unit;
+        break;
+    }
+    case QMC_SECTION_IMPORTS: {
+        if (!imports.read(reader, header->imports))
+            return false;
+        foreach (const QV4::CompiledData::Import &import, imports) {
+            if (import.uriIndex >= header->strings || import.qualifierIndex >= header->strings)
+                return false;
+        }
+        break;
+    }
+    case QMC_SECTION_STRINGS: {
+        // strings are the string table of the unit, older files repeat
+        // them here and need to be read past
+        if (header->version >= 2)
+            break;
+        for (int i = 0; i < (int)header->strings; i++) {
+            QString string;
+            if (!readString(string, reader))
+                return false;
+        }
+        break;
+    }
+    case QMC_SECTION_NAMESPACES: {
+        for (int i = 0; i < (int)header->namespaces; i++) {
+            QString ns;
+            if (!readSharedString(ns, reader))
+                return false;
+            namespaces.append(ns);
         }
+        break;
+    }
+    case QMC_SECTION_TYPE_REFERENCES: {
+        if (!readTable(typeReferences, header->typeReferences, QMC_UNIT_COMPACT_DELTA_TYPE_REFERENCE, reader))
+            return false;
+        break;
+    }
+    case QMC_SECTION_CODE_REFS: {
+        codeRefSizes.resize(header->codeRefs);
+        for (int i = 0; i < (int)header->codeRefs; i++) {
+            quint32 codeRefLen = 0;
+            if (!readCount(codeRefLen, reader))
+                return false;
+            //qDebug() << "Codereflen" << QString("%1").arg(codeRefLen, 0, 16);
+            // with code section the code is laid out at the end of the unit
+            const char *code = NULL;
+            if (!(header->flags & QMC_UNIT_FLAG_CODE_SECTION)) {
+                code = reader.readInPlace(codeRefLen);
+                if (!code)
+                    return false;
+            }
+
+            quint32 linkCallsCount = 0;
+            if (!readCount(linkCallsCount, reader))
+                return false;
+            QmcUnitTable<QmcUnitCodeRefLinkCall> linkData;
+            if (!readTable(linkData, linkCallsCount, QMC_UNIT_COMPACT_DELTA_LINK_CALL, reader))
+                return false;
+            linkCalls.append(linkData);
 
-        // read code to temporary variable, there will be executable code if it
-        QVector<char> code;
-        code.resize(codeRefLen);
-        if (!readData(code.data(), codeRefLen, stream)) {
+            quint32 constantVectorLen = 0;
+            if (!readCount(constantVectorLen, reader))
+                return false;
+            QVector<QV4::Primitive > constantVector;
+            if (constantVectorLen > 0 && (header->flags & QMC_UNIT_FLAG_SHARED_POOL)) {
+                quint32 poolIndex = 0;
+                if (!readCount(poolIndex, reader) || !fileData->pool->constants(poolIndex, constantVectorLen, &constantVector))
+                    return false;
+            } else if (constantVectorLen > 0) {
+                if (!reader.canRead(constantVectorLen, sizeof(QV4::Primitive)))
+                    return false;
+                constantVector.resize(constantVectorLen);
+                if (!reader.read(constantVector.data(), sizeof(QV4::Primitive) * constantVectorLen, Q_ALIGNOF(QV4::Primitive)))
+                    return false;
+            }
+            compilationUnit->constantValues.append(constantVector);
+
+            codeRefData.append(code);
+            codeRefSizes[i] = codeRefLen;
+        }
+        break;
+    }
+    case QMC_SECTION_OBJECT_INDEX_TO_ID_ROOT: {
+        if (!readTable(objectIndexToIdRoot, header->objectIndexToIdRoot, QMC_UNIT_COMPACT_DELTA_OBJECT_INDEX_TO_ID, reader))
             return false;
+        break;
+    }
+    case QMC_SECTION_OBJECT_INDEX_TO_ID_COMPONENT: {
+        for (uint i = 0; i < header->objectIndexToIdComponent; i++) {
+            QmcUnitObjectIndexToIdComponent mapping;
+            if (!readCount(mapping.componentIndex, reader))
+                return false;
+            quint32 len;
+            if (!readCount(len, reader))
+                return false;
+            QmcUnitTable<QmcUnitObjectIndexToId> mappings;
+            if (!readTable(mappings, len, QMC_UNIT_COMPACT_DELTA_OBJECT_INDEX_TO_ID, reader))
+                return false;
+            if (len > 0) {
+                mapping.mappings.resize(len);
+                memcpy(mapping.mappings.data(), mappings.constData(), sizeof (QmcUnitObjectIndexToId) * len);
+            }
+            objectIndexToIdComponent.append(mapping);
         }
-        codeRefData.append(code);
-
-        quint32 linkCallsCount = 0;
-        if (!readData((char *)&linkCallsCount, sizeof(quint32), stream))
+        break;
+    }
+    case QMC_SECTION_ALIASES: {
+        if (!readTable(aliases, header->aliases, QMC_UNIT_COMPACT_DELTA_ALIAS, reader))
             return false;
-        if (linkCallsCount > QMC_UNIT_MAX_CODE_REF_LINK_CALLS)
+        break;
+    }
+    case QMC_SECTION_CUSTOM_PARSERS: {
+        for (uint i = 0; i < header->customParsers; i++) {
+            quint32 objectIndex = 0;
+            if (!readCount(objectIndex, reader))
+                return false;
+            quint32 artifactLen = 0;
+            if (!readCount(artifactLen, reader))
+                return false;
+            QQmlCompiledData::CustomParserData customParserData;
+            const char *artifact = reader.readInPlace(artifactLen);
+            if (!artifact)
+                return false;
+            QBitArray bindings;
+            if (!readBitArray(bindings, reader))
+                return false;
+            customParserData.compilationArtifact = QByteArray::fromRawData(artifact, artifactLen);
+            customParserData.bindings = bindings;
+            customParsers.insert(objectIndex, customParserData);
+        }
+        break;
+    }
+    case QMC_SECTION_CUSTOM_PARSER_BINDINGS: {
+        QmcUnitTable<quint32> bindings;
+        if (!readTable(bindings, header->customParserBindings, 0, reader))
             return false;
-        QVector<QmcUnitCodeRefLinkCall> linkData;
-        if (linkCallsCount > 0) {
-            linkData.resize(linkCallsCount);
-            if (!readData((char *)linkData.data(), sizeof (QmcUnitCodeRefLinkCall) * linkCallsCount, stream))
+        customParserBindings.resize(bindings.size());
+        for (int i = 0; i < bindings.size(); i++)
+            customParserBindings[i] = bindings[i];
+        break;
+    }
+    case QMC_SECTION_DEFERRED_BINDINGS: {
+        for (uint i = 0; i < header->deferredBindings; i++) {
+            quint32 objectIndex = 0;
+            if (!readCount(objectIndex, reader))
                 return false;
+            QBitArray bindings;
+            if (!readBitArray(bindings, reader))
+                return false;
+            deferredBindings.insert(objectIndex, bindings);
         }
-        linkCalls.append(linkData);
-
-        quint32 constantVectorLen = 0;
-        if (!readData((char *)&constantVectorLen, sizeof(quint32), stream))
+        break;
+    }
+    case QMC_SECTION_DEPENDENCIES: {
+        // older units do not list their dependencies, version 1 is read
+        // sequentially and may be followed by other data
+        if (header->version < 2 || reader.remaining() == 0)
+            break;
+        quint32 count = 0;
+        const qint64 minimumSize = header->flags & QMC_UNIT_FLAG_SHARED_POOL ? 1 : sizeof (quint32);
+        if (!readCount(count, reader) || !reader.canRead(count, minimumSize))
             return false;
-        if (constantVectorLen > QMC_UNIT_MAX_CONSTANT_VECTOR_SIZE)
+        for (quint32 i = 0; i < count; i++) {
+            QString dependency;
+            if (!readSharedString(dependency, reader))
+                return false;
+            dependencyFiles.append(dependency);
+        }
+        break;
+    }
+    case QMC_SECTION_META_OBJECTS: {
+        // data is checked against the objects when it is used
+        if (header->version < 2 || reader.remaining() == 0)
+            break;
+        quint32 count = 0;
+        if (!readCount(count, reader) || !reader.canRead(count, sizeof (quint32)))
             return false;
-        QVector<QV4::Primitive > constantVector;
-        if (constantVectorLen > 0) {
-            constantVector.resize(constantVectorLen);
-            if (constantVectorLen == 0)
-                continue;
-            if (!readData((char *)constantVector.data(), constantVectorLen, stream))
+        for (quint32 i = 0; i < count; i++) {
+            QmcUnitMetaObject metaObject;
+            quint32 dataLen = 0;
+            if (!readCount(metaObject.objectIndex, reader) || !readCount(metaObject.propertyIndexCacheStart, reader)
+                    || !readCount(metaObject.methodIndexCacheStart, reader) || !readCount(metaObject.signalHandlerIndexCacheStart, reader)
+                    || !readCount(dataLen, reader))
+                return false;
+            const char *data = reader.readInPlace(dataLen);
+            if (!data)
                 return false;
+            metaObject.data = QByteArray::fromRawData(data, dataLen);
+            metaObjects.insert(metaObject.objectIndex, metaObject);
         }
-        constantVectors.append(constantVector);
-
-#if 0
-        QV4::ExecutableAllocator::Allocation *executableMemory =
-                QQmlEnginePrivate::get(engine)->v4engine()->executableAllocator->allocate(codeRefLen);
-        if (!executableMemory)
+        break;
+    }
+    case QMC_SECTION_TYPE_RESOLUTIONS: {
+        // resolutions that do not match the type references are not used
+        if (header->version < 2 || reader.remaining() == 0)
+            break;
+        quint32 count = 0;
+        if (!readCount(moduleFingerprint, reader) || !readCount(count, reader) || !reader.canRead(count, sizeof (quint32)))
             return false;
-        allocations.append(executableMemory);
-        char *codeExec = (char *) executableMemory->start();
-        //ASSERT(code);
-        JSC::ExecutableAllocator::makeWritable(codeExec, codeRefLen);
-        memcpy(codeExec, code.data(), codeRefLen);
-
-        JSC::MacroAssemblerCodePtr codePtr = JSC::MacroAssemblerCodePtr::createFromExecutableAddress(codeExec);
-        JSC::MacroAssemblerCodeRef codeRef = JSC::MacroAssemblerCodeRef::createSelfManagedCodeRef(codePtr);
-        compilationUnit->constantValues.append(constantVectors);
-#else
-        QV4::ExecutableAllocator* executableAllocator = QQmlEnginePrivate::get(engine)->v4engine()->executableAllocator;
-        QmcBackedInstructionSelection *isel = new QmcBackedInstructionSelection(compilationUnit);
-        QV4::IR::Function nullFunction(0, 0);
-        QV4::JIT::Assembler* as = new QV4::JIT::Assembler(isel, &nullFunction, executableAllocator, 6); // 6 == max argc for calls to built-ins with an argument array
-
-        QList<QV4::JIT::Assembler::CallToLink>& callsToLink = as->callsToLink();
-        foreach (const QmcUnitCodeRefLinkCall &call, linkData) {
-            // resolve function pointer
-            if (call.index > sizeof (QMC_LINK_TABLE) / sizeof (QmcLinkEntry))
+        for (quint32 i = 0; i < count; i++) {
+            QmcUnitTypeResolution resolution;
+            quint32 majorVersion = 0;
+            quint32 minorVersion = 0;
+            if (!readCount(resolution.index, reader) || !readCount(resolution.kind, reader)
+                    || !readCount(majorVersion, reader) || !readCount(minorVersion, reader)
+                    || !readSharedString(resolution.name, reader))
                 return false;
-            void *functionPtr = QMC_LINK_TABLE[call.index].addr;
-            QV4::JIT::Assembler::CallToLink c;
-            JSC::AssemblerLabel label(call.offset);
-            c.call = QV4::JIT::Assembler::Call(label, QV4::JIT::Assembler::Call::Linkable);
-            c.externalFunction = JSC::FunctionPtr((quint64(*)(void))functionPtr);
-#if QT_VERSION > QT_VERSION_CHECK(5,3,0)
-            c.label.m_label = label;
-#endif
-            callsToLink.append(c);
+            resolution.majorVersion = majorVersion;
+            resolution.minorVersion = minorVersion;
+            typeResolutions.insert(resolution.index, resolution);
         }
-
-        QV4::JIT::Assembler::ConstantTable& constTable = as->constantTable();
-        int iii = 0;
-        foreach (const QV4::Primitive &p, constantVector) {
-            int idx = constTable.add(p);
-            Q_ASSERT(idx == iii++);
+        break;
+    }
+    case QMC_SECTION_CODE: {
+        if (!(header->flags & QMC_UNIT_FLAG_CODE_SECTION))
+            break;
+        // version 1 stores the size, version 2 section is the code region
+        const QmcUnitSection *section = findSection(sections, QMC_SECTION_CODE);
+        if (section && (section->flags & QMC_UNIT_SECTION_FLAG_COMPRESSED)) {
+            quint64 size;
+            if (!reader.read(&size, sizeof (size)) || size > INT_MAX)
+                return false;
+            codeSectionSize = size;
+            codeSectionCompressedSize = reader.remaining();
+            codeSection = reader.readInPlace(codeSectionCompressedSize);
+        } else if (header->version >= 2) {
+            codeSectionSize = reader.size();
+            codeSection = reader.readInPlace(codeSectionSize);
+        } else {
+            if (!reader.read(codeSectionSize))
+                return false;
+            if (codeSectionSize > 0)
+                codeSection = reader.readInPlace(codeSectionSize, QMC_UNIT_CODE_SECTION_ALIGNMENT);
         }
-        as->appendData(code.data(), codeRefLen);
-
-        // TBD: need to restore the state of the assembler
-        // need done:
-        //  _executableAllocator
-        //  _as->_callsToLink
-        //  _as->_constTable
-        //  _as->_constTable->_values
-        //  _as->m_assembler = _as (qv4isel_masm.cpp:143)
-        // need maybe done:
-        //  _as->_isel
-        //  _as->_isel->addConstantTable (values from _as->_constTable->_values will be appended here)
-        //  _as->_isel->compilationUnit (need to be final compilation unit, QV4::JIT::CompilationUnit)
-        //  _as->m_formatter (X86Assembler.h:2066~2563)
-        //  _as->m_formatter->m_buffer (X86Assembler.h:2562 + AssemblerBuffer.h:63)
-        //  _as->m_formatter->m_buffer->m_index (AssemblerBuffer.h:174)
-        //  _as->m_formatter->m_buffer->m_buffer (AssemblerBuffer.h:172)
-        //  _as->m_formatter->m_buffer->m_index (size of code)
-        //  _as->m_formatter->m_buffer->m_buffer (code pointer)
-        // need:
-        //  function->maxNumberOfArguments
-        //  function->tempCount
-        // need ?:
-        //  _constTable->_toPatch
-        //  _patches -> need to be preparsed
-        //  _dataLabelPatches
-        //  exceptionPropagationJumps
-        //  _labelPatches
-        int dummySize;
-        JSC::MacroAssemblerCodeRef codeRef = as->link(&dummySize);
-        Q_ASSERT(dummySize == (int)codeRefLen);
-        delete as;
-        this->codeRefData.append(codeRefData);
-#endif
-
-        compilationUnit->codeRefs.append(codeRef);
-        codeRefSizes[i] = codeRefLen;
-    }
-
-    // object index -> id
-    for (uint i = 0; i < header->objectIndexToIdRoot; i++) {
-        QmcUnitObjectIndexToId mapping;
-        if (!readData((char *)&mapping, sizeof (QmcUnitObjectIndexToId), stream))
+        if (codeSectionSize > 0 && !codeSection)
             return false;
-        objectIndexToIdRoot.append(mapping);
+        break;
+    }
+    default:
+        // unknown sections are skipped
+        break;
     }
+    return true;
+}
 
-    // component index + object index -> id
-    for (uint i = 0; i < header->objectIndexToIdComponent; i++) {
-        QmcUnitObjectIndexToIdComponent mapping;
-        if (!readData((char *)&mapping.componentIndex, sizeof (quint32), stream))
-            return false;
-        quint32 len;
-        if (!readData((char *)&len, sizeof (quint32), stream))
-            return false;
-        if (len > QMC_UNIT_MAX_OBJECT_INDEX_TO_ID_COMPONENT_MAPPINGS)
+bool QmcUnit::readBitArray(QBitArray &bitArray, QmcUnitReader &reader)
+{
+    quint32 size = 0;
+    if (!readCount(size, reader))
+        return false;
+    if (header->flags & QMC_UNIT_FLAG_COMPACT_TABLES) {
+        const char *bytes = reader.readInPlace((quint64(size) + 7) / 8);
+        if (!bytes)
             return false;
-        if (len > 0) {
-            mapping.mappings.resize(len);
-            if (!readData((char *)mapping.mappings.data(), sizeof (QmcUnitObjectIndexToId) * len, stream))
+        bitArray.resize(size);
+        for (int i = 0; i < bitArray.size(); i++) {
+            if ((uchar(bytes[i / 8]) >> (i % 8)) & 1)
+                bitArray.setBit(i);
+        }
+        return true;
+    }
+
+    QmcUnitTable<quint32> words;
+    if (!words.read(reader, QMC_UNIT_BIT_ARRAY_LENGTH(quint64(size))))
+        return false;
+
+    bitArray.resize(size);
+    for (int i = 0; i < bitArray.size(); i++) {
+        if ((words[i / 32] >> (i % 32)) & 1)
+            bitArray.setBit(i);
+    }
+    return true;
+}
+
+char *QmcUnit::mapCodeSection(qint64 size)
+{
+    // map the section privately from the file, pages that are not
+    // relocated stay shared with the page cache
+    if (!fileData->mappedFile)
+        return NULL;
+    const qint64 offset = fileData->mappedFileOffset + (codeSection - fileData->data.constData());
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize <= 0 || offset % pageSize)
+        return NULL;
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileData->mappedFile->handle(), offset);
+    if (p == MAP_FAILED)
+        return NULL;
+    codeMapping = p;
+    codeMappingSize = size;
+    return (char *)p;
+}
+
+char *QmcUnit::allocateCode(qint64 size)
+{
+    // anonymous mapping that is not tied to the allocator of any engine
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    codeMapping = p;
+    codeMappingSize = size;
+    return (char *)p;
+}
+
+bool QmcUnit::linkCodeRefs()
+{
+    // lay out all code refs in one executable region so that the whole
+    // unit needs only one allocation and one protection change
+    const bool positionIndependent = header->flags & QMC_UNIT_FLAG_PIC;
+    const quint32 linkTableSize = sizeof (QMC_LINK_TABLE) / sizeof (QmcLinkEntry);
+    QVector<quint32> constantTableSizes;
+    foreach (const QVector<QV4::Primitive> &constantTable, compilationUnit->constantValues)
+        constantTableSizes.append(constantTable.size());
+
+    // lazy functions are left out of the region, position independent code
+    // and code sections are linked as a whole, functions of a unit flagged
+    // with a code section have no code of their own even if it is missing
+    QVector<quint32> linkedSizes = codeRefSizes;
+    if (loader && loader->isLazyLinkingEnabled() && !positionIndependent
+            && !(header->flags & QMC_UNIT_FLAG_CODE_SECTION)) {
+        foreach (int i, lazyFunctions()) {
+            if (linkedSizes[i] == 0)
+                continue;
+            if (!linkCode(NULL, codeRefSizes[i], linkCalls[i], compilationUnit->constantValues[i]))
                 return false;
+            compilationUnit->addLazyFunction(i, codeRefData[i], codeRefSizes[i], linkCalls[i]);
+            linkedSizes[i] = 0;
         }
-        objectIndexToIdComponent.append(mapping);
     }
+    const QmcCodeLayout layout(linkedSizes, constantTableSizes, positionIndependent, 0);
 
-    for (uint i = 0; i < header->aliases; i++) {
-        QmcUnitAlias alias;
-        if (!readData((char *)&alias, sizeof (QmcUnitAlias), stream))
-            return false;
-        aliases.append(alias);
+    if (layout.size == 0) {
+        compilationUnit->codeRefs.resize(codeRefSizes.size());
+        return true;
     }
+    if (codeSection && !checkCodeSection())
+        return false;
 
-    for (uint i = 0; i < header->customParsers; i++) {
-        quint32 objectIndex = 0;
-        if (!readData((char *)&objectIndex, sizeof (quint32), stream))
-            return false;
-        quint32 len = 0;
-        if (!readData((char *)&len, sizeof (quint32), stream))
-            return false;
-        if (len > QMC_UNIT_MAX_CUSTOM_PARSER_DATA_LENGTH)
+    // position independent code refers to no unit or engine, it is linked
+    // once and shared by all units of the file
+    RefPtr<JSC::ExecutableMemoryHandle> memory;
+    QMutexLocker locker(positionIndependent ? &fileData->mutex : NULL);
+    if (positionIndependent && fileData->code) {
+        if (fileData->codeSize < layout.size)
             return false;
-        QQmlCompiledData::CustomParserData customParserData;
-        QByteArray artifact;
-        artifact.resize(len);
-        if (!readData(artifact.data(), (int)len, stream))
-            return false;
-        if (!readData((char *)&len, sizeof (quint32), stream))
-            return false;
-        if (len > QMC_UNIT_MAX_CUSTOM_PARSER_BINDING_LENGTH)
+        appendCodeRefs(memory, (char *)fileData->code, layout, linkedSizes);
+        return true;
+    }
+
+    // call table of the code section may be shorter than the link table
+    quint32 callTableSize = 0;
+    qint64 regionSize = 0;
+    if (codeSection) {
+        if (codeSectionSize < layout.size)
             return false;
-        QBitArray bindings;
-        bindings.resize(len);
-        if (!readBitArray(bindings, stream))
+        regionSize = codeSectionSize;
+        if (positionIndependent)
+            callTableSize = qMin<qint64>(linkTableSize, (regionSize - layout.callTableOffset) / sizeof(void *));
+    } else {
+        if (header->flags & QMC_UNIT_FLAG_CODE_SECTION)
             return false;
-        customParserData.compilationArtifact = artifact;
-        customParserData.bindings = bindings;
-        customParsers.insert(objectIndex, customParserData);
+        if (positionIndependent)
+            callTableSize = linkTableSize;
+        regionSize = layout.size + qint64(callTableSize) * sizeof(void *);
     }
+    if (regionSize > INT_MAX)
+        return false;
 
-    customParserBindings.resize(header->customParserBindings);
-    for (uint i = 0; i < header->customParserBindings; i++) {
-        quint32 d = 0;
-        if (!readData((char *)&d, sizeof (quint32), stream))
+    char *region = codeSection && !codeSectionCompressedSize ? mapCodeSection(regionSize) : NULL;
+    if (!region) {
+        // shared code must outlive the engine and its allocator
+        if (positionIndependent) {
+            region = allocateCode(regionSize);
+        } else {
+            QV4::ExecutableAllocator *executableAllocator = QQmlEnginePrivate::get(engine)->v4engine()->executableAllocator;
+            memory = adoptRef(new JSC::ExecutableMemoryHandle(executableAllocator, regionSize));
+            region = (char *)memory->start();
+            if (region)
+                JSC::ExecutableAllocator::makeWritable(region, regionSize);
+        }
+        if (!region)
             return false;
-        customParserBindings[i] = d;
+        if (codeSectionCompressedSize) {
+            if (!QmcCompression::decompress(codeSection, codeSectionCompressedSize, region, regionSize))
+                return false;
+        } else if (codeSection)
+            memcpy(region, codeSection, regionSize);
     }
 
-    for (uint i = 0; i < header->deferredBindings; i++) {
-        quint32 objectIndex = 0;
-        if (!readData((char *)&objectIndex, sizeof (quint32), stream))
-            return false;
-        quint32 len = 0;
-        if (!readData((char *)&len, sizeof (quint32), stream))
-            return false;
-        if (len > QMC_UNIT_MAX_DEFERRED_BINDING_LENGTH)
-            return false;
-        QBitArray bindings;
-        bindings.resize(len);
-        if (!readBitArray(bindings, stream))
+    for (int i = 0; i < linkedSizes.size(); i++) {
+        const quint32 len = linkedSizes[i];
+        if (len == 0)
+            continue;
+        char *dst = region + layout.codeRefOffsets[i];
+        const QVector<QV4::Primitive> &constantTable = compilationUnit->constantValues[i];
+        if (!codeSection) {
+            memcpy(dst, codeRefData[i], len);
+            if (positionIndependent && !constantTable.isEmpty())
+                memcpy(region + layout.constantTableOffsets[i], constantTable.constData(), constantTable.size() * sizeof(QV4::Primitive));
+        }
+
+        // position independent code only needs the entries validated
+        if (!linkCode(positionIndependent ? NULL : dst, len, linkCalls[i], constantTable))
             return false;
-        deferredBindings.insert(objectIndex, bindings);
+        if (positionIndependent) {
+            foreach (const QmcUnitCodeRefLinkCall &call, linkCalls[i]) {
+                if (call.index != QMC_LINK_INDEX_CONSTANT_TABLE && call.index >= callTableSize)
+                    return false;
+            }
+        }
+    }
 
+    if (positionIndependent) {
+        void **callTable = reinterpret_cast<void **>(region + layout.callTableOffset);
+        for (quint32 i = 0; i < callTableSize; i++)
+            callTable[i] = QMC_LINK_TABLE[i].addr;
     }
 
-#if 0
-    // script references
-    for (int i = 0; i < (int)header->scriptReferences; i++) {
-        QQmlTypeData::ScriptReference scriptReference;
-        if (!readData((char *)&scriptReference, sizeof (QQmlTypeData::ScriptReference), stream))
+    if (codeMapping) {
+        if (mprotect(codeMapping, codeMappingSize, PROT_READ | PROT_EXEC))
             return false;
-        //scriptReferences.append(scriptReference);
-    }
-#endif
+    } else
+        JSC::ExecutableAllocator::makeExecutable(region, regionSize);
+    JSC::MacroAssembler::cacheFlush(region, regionSize);
+
+    if (positionIndependent) {
+        fileData->code = codeMapping;
+        fileData->codeSize = codeMappingSize;
+    } else if (codeMapping)
+        compilationUnit->setCodeMapping(codeMapping, codeMappingSize);
+    codeMapping = NULL;
+    codeMappingSize = 0;
+    appendCodeRefs(memory, region, layout, linkedSizes);
+    return true;
+}
 
+bool QmcUnit::linkCode(char *dst, quint32 len, const QmcUnitTable<QmcUnitCodeRefLinkCall> &calls,
+                       const QVector<QV4::Primitive> &constantTable)
+{
+    const quint32 linkTableSize = sizeof (QMC_LINK_TABLE) / sizeof (QmcLinkEntry);
+    foreach (const QmcUnitCodeRefLinkCall &call, calls) {
+        if (call.index == QMC_LINK_INDEX_CONSTANT_TABLE) {
+            if (call.offset < QmcRelocation::pointerRelocationSize() || call.offset > len || constantTable.isEmpty())
+                return false;
+            if (dst)
+                QmcRelocation::linkPointer(dst, call.offset, const_cast<QV4::Primitive *>(constantTable.constData()));
+        } else {
+            if (call.index >= linkTableSize || call.offset < QmcRelocation::callRelocationSize() || call.offset > len)
+                return false;
+            if (dst)
+                QmcRelocation::linkCall(dst, call.offset, QMC_LINK_TABLE[call.index].addr);
+        }
+    }
     return true;
 }
 
-bool QmcUnit::readBitArray(QBitArray &bitArray, QDataStream &stream)
+QVector<int> QmcUnit::lazyFunctions() const
 {
-    int len = QMC_UNIT_BIT_ARRAY_LENGTH(bitArray.size());
-    quint32 *buf = new quint32[len];
-    if (!buf)
-        return false;
-    if (!readData((char *)buf, len * sizeof(quint32), stream)) {
-        delete buf;
-        return false;
+    // scripts are run only when first imported into a context
+    QVector<int> functions;
+    if (type == QMC_JS) {
+        for (int i = 0; i < codeRefSizes.size(); i++)
+            functions.append(i);
+        return functions;
     }
 
-    quint32 *p = buf;
-    for (int i = 0; i < bitArray.size(); i++) {
-        if (i % 32 == 0 && i > 0) {
-            p++;
+    // functions and bindings of objects created by inline components,
+    // objects of the component itself belong to the enclosing scope
+    QVector<quint32> objects;
+    foreach (const QmcUnitObjectIndexToIdComponent &component, objectIndexToIdComponent) {
+        if (component.componentIndex >= qmlUnit->nObjects)
+            continue;
+        const QV4::CompiledData::Object *obj = qmlUnit->objectAt(component.componentIndex);
+        const QV4::CompiledData::Binding *binding = obj->bindingTable();
+        for (quint32 i = 0; i < obj->nBindings; i++, binding++) {
+            if (binding->type == QV4::CompiledData::Binding::Type_Object)
+                objects.append(binding->value.objectIndex);
+        }
+    }
+
+    QSet<quint32> seen;
+    while (!objects.isEmpty()) {
+        const quint32 objectIndex = objects.takeLast();
+        if (objectIndex >= qmlUnit->nObjects || seen.contains(objectIndex))
+            continue;
+        seen.insert(objectIndex);
+        const QV4::CompiledData::Object *obj = qmlUnit->objectAt(objectIndex);
+        const quint32 *functionIdx = obj->functionOffsetTable();
+        for (quint32 i = 0; i < obj->nFunctions; i++, functionIdx++) {
+            if (*functionIdx < quint32(codeRefSizes.size()))
+                functions.append(*functionIdx);
+        }
+        const QV4::CompiledData::Binding *binding = obj->bindingTable();
+        for (quint32 i = 0; i < obj->nBindings; i++, binding++) {
+            if (binding->type == QV4::CompiledData::Binding::Type_Script) {
+                if (binding->value.compiledScriptIndex < quint32(codeRefSizes.size()))
+                    functions.append(binding->value.compiledScriptIndex);
+            } else if (binding->type >= QV4::CompiledData::Binding::Type_Object)
+                objects.append(binding->value.objectIndex);
+        }
+    }
+    return functions;
+}
+
+void QmcUnit::appendCodeRefs(RefPtr<JSC::ExecutableMemoryHandle> &memory, char *region, const QmcCodeLayout &layout,
+                             const QVector<quint32> &sizes)
+{
+    // allocated region is owned by the first code ref which starts it, the
+    // rest live inside it and are kept alive by the same compilation unit,
+    // mapped code is owned by the compilation unit or its file data like
+    // the rest of the data
+    bool owned = !memory.get();
+    for (int i = 0; i < sizes.size(); i++) {
+        if (sizes[i] == 0) {
+            compilationUnit->codeRefs.append(JSC::MacroAssemblerCodeRef());
+        } else if (!owned) {
+            Q_ASSERT(layout.codeRefOffsets[i] == 0);
+            compilationUnit->codeRefs.append(JSC::MacroAssemblerCodeRef(memory.release()));
+            owned = true;
+        } else {
+            JSC::MacroAssemblerCodePtr codePtr(region + layout.codeRefOffsets[i]);
+            compilationUnit->codeRefs.append(JSC::MacroAssemblerCodeRef::createSelfManagedCodeRef(codePtr));
         }
-        if ((*p >> (i % 32)) & 1)
-            bitArray.setBit(i);
     }
-    delete buf;
-    return true;
 }
 
-bool QmcUnit::readString(QString &string, QDataStream &stream)
+
+
+bool QmcUnit::readString(QString &string, QmcUnitReader &reader)
 {
     quint32 stringLen = 0;
-    char buf[QMC_UNIT_STRING_MAX_LEN];
-    int ret = stream.readRawData((char*)&stringLen, sizeof(quint32));
-    if (ret != sizeof(quint32))
+    if (!reader.read(stringLen))
         return false;
-    if (ret == 0)
-        return true;
-    if (ret > QMC_UNIT_STRING_MAX_LEN)
+    const char *str = reader.readInPlace(stringLen);
+    if (!str)
         return false;
-    ret = stream.readRawData(buf, stringLen);
-    if (ret != (int)stringLen)
-        return false;
-    string.append(QString::fromUtf8(buf, stringLen));
+    string = QString::fromUtf8(str, stringLen);
     return true;
 }
 
-bool QmcUnit::readData(char *data, int len, QDataStream &stream)
+bool QmcUnit::readSharedString(QString &string, QmcUnitReader &reader)
 {
-    if (stream.readRawData(data, len) != len)
-        return false;
-    else
-        return true;
+    if (!(header->flags & QMC_UNIT_FLAG_SHARED_POOL))
+        return readString(string, reader);
+    quint32 index = 0;
+    return readCount(index, reader) && fileData->pool->string(index, &string);
 }
 
-bool QmcUnit::checkHeader(QmcUnitHeader *header)
+bool QmcUnit::checkHeader(QmcUnitHeader *header, qint64 size)
 {
     if (header->type != QMC_QML && header->type != QMC_JS)
         return false;
 
-    if (header->version != QMC_UNIT_VERSION || strncmp(QMC_UNIT_MAGIC_STR, header->magic, strlen(QMC_UNIT_MAGIC_STR)))
-        return false;
-
-    if (header->sizeQmlUnit > QMC_UNIT_MAX_QML_UNIT_SIZE || header->sizeQmlUnit < sizeof (QV4::CompiledData::QmlUnit))
-        return false;
-
-    if (header->sizeUnit > QMC_UNIT_MAX_COMPILATION_UNIT_SIZE || header->sizeUnit < sizeof (QV4::CompiledData::Unit))
-        return false;
-
-    if (header->imports > QMC_UNIT_MAX_IMPORTS)
+    if (header->flags & ~(QMC_UNIT_FLAG_ALIGNED | QMC_UNIT_FLAG_PIC | QMC_UNIT_FLAG_CODE_SECTION | QMC_UNIT_FLAG_COMPACT_TABLES
+                          | QMC_UNIT_FLAG_SHARED_POOL))
         return false;
 
-    if (header->strings > QMC_UNIT_MAX_STRINGS)
+    if ((header->flags & QMC_UNIT_FLAG_CODE_SECTION) && !(header->flags & QMC_UNIT_FLAG_ALIGNED))
         return false;
 
-    if (header->namespaces > QMC_UNIT_MAX_NAMESPACES)
+    if ((header->flags & QMC_UNIT_FLAG_COMPACT_TABLES) && header->version < 3)
         return false;
 
-    if (header->typeReferences > QMC_UNIT_MAX_TYPE_REFERENCES)
+    // older units are not tagged and are assumed to match
+    if (header->version >= 4 ? header->architecture != QmcRelocation::architecture() : header->architecture != QMC_ARCH_NONE)
         return false;
 
-    if (header->codeRefs > QMC_UNIT_MAX_CODE_REFS)
+    if ((header->flags & QMC_UNIT_FLAG_PIC) && !QmcRelocation::supportsPositionIndependentCode())
         return false;
 
-    if (header->objectIndexToIdRoot > QMC_UNIT_MAX_OBJECT_INDEX_TO_ID_ROOT)
+    if (header->version < QMC_UNIT_MIN_VERSION || header->version > QMC_UNIT_VERSION || strncmp(QMC_UNIT_MAGIC_STR, header->magic, strlen(QMC_UNIT_MAGIC_STR)))
         return false;
 
-    if (header->objectIndexToIdComponent > QMC_UNIT_MAX_OBJECT_INDEX_TO_ID_COMPONENT)
+    if (header->sizeQmlUnit < sizeof (QV4::CompiledData::QmlUnit) || header->sizeQmlUnit > size)
         return false;
 
-    if (header->aliases > QMC_UNIT_MAX_ALIASES)
+    if (header->sizeUnit < sizeof (QV4::CompiledData::Unit) || header->sizeUnit > size)
         return false;
 
-    if (header->customParsers > QMC_UNIT_MAX_CUSTOM_PARSERS)
-        return false;
-
-    if (header->customParserBindings > QMC_UNIT_MAX_CUSTOM_PARSER_BINDINGS)
-        return false;
-
-    if (header->deferredBindings > QMC_UNIT_MAX_DEFERRED_BINDINGS)
-        return false;
+    // counts are limited by the unit size, each record takes at least the
+    // given number of bytes so larger counts can only come from corrupted
+    // data, the actual records are bounds checked when they are read
+    // compact records take at least a byte for each quint32 field
+    const bool compact = header->flags & QMC_UNIT_FLAG_COMPACT_TABLES;
+    const struct {
+        quint32 count;
+        qint64 minimumSize;
+        bool compact;
+    } counts[] = {
+        { header->imports, sizeof (QV4::CompiledData::Import), false },
+        { header->strings, sizeof (quint32), false },
+        { header->namespaces, sizeof (quint32), true }, // pooled strings are indexes
+        { header->typeReferences, sizeof (QmcUnitTypeReference), true },
+        { header->codeRefs, 3 * sizeof (quint32), true },
+        { header->objectIndexToIdRoot, sizeof (QmcUnitObjectIndexToId), true },
+        { header->objectIndexToIdComponent, 2 * sizeof (quint32), true },
+        { header->aliases, sizeof (QmcUnitAlias), true },
+        { header->customParsers, 3 * sizeof (quint32), true },
+        { header->customParserBindings, sizeof (quint32), true },
+        { header->deferredBindings, 2 * sizeof (quint32), true }
+    };
+    for (uint i = 0; i < sizeof (counts) / sizeof (counts[0]); i++) {
+        qint64 minimumSize = counts[i].minimumSize;
+        if (compact && counts[i].compact)
+            minimumSize /= sizeof (quint32);
+        if (counts[i].count > size / minimumSize)
+            return false;
+    }
 
     return true;
 }
 
 QString QmcUnit::stringAt(int index) const
 {
-    Q_ASSERT(index < strings.size());
-    return strings.at(index);
+    // static unit data is used without copying, see QMC_SECTION_UNIT
+    Q_ASSERT(unit && index < (int)unit->stringTableSize);
+    return unit->stringAt(index);
 }
 
 QT_END_NAMESPACE
@@ -23,6 +23,8 @@
 #include <QObject>
 #include <QDataStream>
 #include <QBitArray>
+#include <QFile>
+#include <QSharedPointer>
 
 #include <private/qqmltypeloader_p.h>
 #include <private/qv4compileddata_p.h>
@@ -32,61 +34,131 @@
 #include <private/qv4assembler_p.h>
 
 #include "qmcfile.h"
+#include "qmcunitreader.h"
+#include "qmcunitcache.h"
+#include "qmccompilationunit.h"
 
 QT_BEGIN_NAMESPACE
 
 class QmcUnitPropertyCacheCreator;
 class QmcTypeUnit;
 class QmcLoader;
+class QmcPackage;
+struct QmcCodeLayout;
 
 struct QmcUnit
 {
     static QmcUnit *loadUnit(QDataStream &stream, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl);
+    // maps the file and uses the data in place, takes ownership of file
+    static QmcUnit *loadUnit(QFile *file, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl);
+    // loads entry of package, mapped package stays mapped while unit exists
+    static QmcUnit *loadUnit(const QmcPackage *package, int entry, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl);
+    // uses the buffer in place, it must stay valid while the unit exists
+    static QmcUnit *loadUnit(const uchar *data, qint64 size, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl);
+    // reading does not touch the engine and can be done in any thread,
+    // units are attached to the engine in its thread, see attach()
+    static QmcUnit *readUnit(QDataStream &stream, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl);
+    static QmcUnit *readUnit(QFile *file, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl);
+    static QmcUnit *readUnit(const QmcPackage *package, int entry, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl);
+    static QmcUnit *readUnit(const uchar *data, qint64 size, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl);
+    // reads from file data shared with other units, see QmcUnitCache
+    static QmcUnit *readUnit(const QSharedPointer<QmcUnitData> &fileData, QQmlEngine *engine, QmcLoader *loader, const QUrl &loadedUrl);
+    // creates the blob and links the code, unit is deleted on failure
+    static QmcUnit *attach(QmcUnit *unit);
     virtual ~QmcUnit();
 
     QString stringAt(int) const;
+    // links or, if dst is NULL, only validates non position independent code
+    static bool linkCode(char *dst, quint32 len, const QmcUnitTable<QmcUnitCodeRefLinkCall> &calls,
+                         const QVector<QV4::Primitive> &constantTable);
 
     // common data
     QQmlEngine *engine;
 
     // data from qmc unit file
-    QList<QV4::CompiledData::Import> imports;
+    QmcUnitTable<QV4::CompiledData::Import> imports;
     QmcUnitHeader *header;
     QV4::CompiledData::QmlUnit* qmlUnit;
     QV4::CompiledData::Unit* unit;
-    QV4::JIT::CompilationUnit *compilationUnit;
-    QList<QVector<char> > codeRefData;
-    QList<QVector<QmcUnitCodeRefLinkCall> > linkCalls;
-    QList<QVector<QV4::Primitive> > constantVectors;
-    QList<QmcUnitTypeReference> typeReferences;
+    QmcCompilationUnit *compilationUnit;
+    QList<QmcUnitTable<QmcUnitCodeRefLinkCall> > linkCalls;
+    QmcUnitTable<QmcUnitTypeReference> typeReferences;
     QUrl url;
     QString urlString;
     QUrl loadedUrl;
-    QList<QString> strings;
     QList<QString> namespaces;
-    QList<QV4::ExecutableAllocator::Allocation *> allocations;
     QList<QQmlTypeData::ScriptReference> scripts;
     QmcFileType type;
     QmcLoader* loader;
     QQmlTypeLoader::Blob *blob; // cast to QmcTypeUnit or QmcScriptUnit
     QList<QQmlError> errors;
     QString name;
-    QList<QmcUnitAlias> aliases;
-    QList<QmcUnitObjectIndexToId> objectIndexToIdRoot;
+    QmcUnitTable<QmcUnitAlias> aliases;
+    QmcUnitTable<QmcUnitObjectIndexToId> objectIndexToIdRoot;
     QList<QmcUnitObjectIndexToIdComponent> objectIndexToIdComponent;
 
     QHash<int, QQmlCompiledData::CustomParserData> customParsers;
     QVector<int> customParserBindings;
     QHash<int, QBitArray> deferredBindings;
-    QVector<int> codeRefSizes;
+    QVector<quint32> codeRefSizes;
+    QmcUnitTable<QmcUnitSection> sections; // empty for version 1
+    quint32 checksumType;
+    QList<QString> dependencyFiles; // relative to loadedUrl, empty for older units
+    QHash<int, QmcUnitMetaObject> metaObjects; // by object index, empty for older units
+    QHash<int, QmcUnitTypeResolution> typeResolutions; // by type reference, empty for older units
+    quint32 moduleFingerprint; // of the modules the type resolutions are valid for
 
 private:
     QmcUnit(QmcUnitHeader *header, const QUrl &url, const QString &urlString, QQmlEngine *engine, QmcLoader *loader, const QString &name, const QUrl &loadedUrl);
-    bool loadUnitData(QDataStream &stream);
-    static bool checkHeader(QmcUnitHeader *header);
-    static bool readString(QString &string, QDataStream &stream);
-    static bool readData(char *data, int len, QDataStream &stream);
-    static bool readBitArray(QBitArray &bitArray, QDataStream &stream);
+    static QmcUnit *readUnit(const QSharedPointer<QmcUnitData> &fileData, QQmlEngine *engine, QmcLoader *loader,
+                             const QUrl &loadedUrl, qint64 *consumed);
+    static bool readSectionDirectory(QmcUnitTable<QmcUnitSection> &sections, quint32 *checksumType, qint64 *end, QmcUnitReader &reader,
+                                     const QmcUnitHeader *header);
+    static const QmcUnitSection *findSection(const QmcUnitTable<QmcUnitSection> &sections, int id);
+    // the code section is neither checked nor decompressed until linked
+    static bool sectionReader(QmcUnitReader &reader, const QmcUnitTable<QmcUnitSection> &sections, int id, QmcUnitData *fileData,
+                              const QmcUnitHeader *header, quint32 checksumType, bool code);
+    // fileData->mutex is held
+    static bool checkSection(const QmcUnitSection *section, QmcUnitData *fileData, quint32 checksumType);
+    bool checkCodeSection();
+    bool loadSection(int id, QmcUnitReader &reader);
+    static bool checkHeader(QmcUnitHeader *header, qint64 size);
+    bool linkCodeRefs();
+    QVector<int> lazyFunctions() const;
+    void appendCodeRefs(RefPtr<JSC::ExecutableMemoryHandle> &memory, char *region, const QmcCodeLayout &layout,
+                        const QVector<quint32> &sizes);
+    char *mapCodeSection(qint64 size);
+    char *allocateCode(qint64 size);
+    static bool readString(QString &string, QmcUnitReader &reader);
+    // from the package pool with QMC_UNIT_FLAG_SHARED_POOL
+    bool readSharedString(QString &string, QmcUnitReader &reader);
+    bool readBitArray(QBitArray &bitArray, QmcUnitReader &reader);
+    // counts and tables are varints with QMC_UNIT_FLAG_COMPACT_TABLES
+    bool readCount(quint32 &count, QmcUnitReader &reader)
+    {
+        if (header->flags & QMC_UNIT_FLAG_COMPACT_TABLES)
+            return reader.readVarint(count);
+        return reader.read(count);
+    }
+    template <typename T>
+    bool readTable(QmcUnitTable<T> &table, quint32 count, quint32 deltaMask, QmcUnitReader &reader)
+    {
+        if (header->flags & QMC_UNIT_FLAG_COMPACT_TABLES)
+            return table.readCompact(reader, count, deltaMask);
+        return table.read(reader, count);
+    }
+
+    // unit file contents, shared with other units of the same file
+    QSharedPointer<QmcUnitData> fileData;
+    // code location while loading
+    QVector<const char *> codeRefData;
+    const char *codeSection;
+    quint32 codeSectionSize;
+    qint64 codeSectionCompressedSize; // 0 if code section is not compressed
+    // code mapped for this unit while linking, moved to fileData if shared
+    // and to the compilation unit otherwise
+    void *codeMapping;
+    qint64 codeMappingSize;
 };
 
 QT_END_NAMESPACE
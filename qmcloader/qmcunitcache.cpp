@@ -0,0 +1,152 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QResource>
+
+#include "qmcunitcache.h"
+
+#include <limits.h>
+#include <sys/mman.h>
+
+Q_GLOBAL_STATIC(QmcUnitCache, unitCache)
+
+QmcUnitData::QmcUnitData(const QByteArray &data, const QSharedPointer<QFile> &mappedFile, qint64 mappedFileOffset,
+                         const QSharedPointer<QmcPackagePool> &pool)
+    : mappedFile(mappedFile),
+      data(data),
+      mappedFileOffset(mappedFileOffset),
+      pool(pool),
+      code(NULL),
+      codeSize(0)
+{
+}
+
+QmcUnitData::~QmcUnitData()
+{
+    if (code)
+        munmap(code, codeSize);
+}
+
+// uncompressed resources are used in place from the binary, aligned ones
+// without any copying, compressed ones are read as QFile would map their
+// compressed data
+bool QmcUnitCache::resourceData(const QString &file, QByteArray *bytes)
+{
+    if (!file.startsWith(QLatin1Char(':')))
+        return false;
+    QResource resource(file);
+    if (!resource.isValid() || resource.isCompressed() || !resource.data()
+            || resource.size() <= 0 || resource.size() > INT_MAX)
+        return false;
+    *bytes = QByteArray::fromRawData((const char *)resource.data(), int(resource.size()));
+    return true;
+}
+
+void QmcUnitCache::addStaticUnit(const QString &file, const uchar *data, qint64 size)
+{
+    if (!data || size <= 0 || size > INT_MAX)
+        return;
+    QmcUnitCache *cache = unitCache();
+    const QString path = QDir::cleanPath(file);
+    QMutexLocker locker(&cache->mutex);
+    cache->staticData[path] = QByteArray::fromRawData((const char *)data, int(size));
+    cache->staticUnits.remove(path);
+}
+
+QSharedPointer<QmcUnitData> QmcUnitCache::file(const QString &file, bool mapping, QString *error)
+{
+    QmcUnitCache *cache = unitCache();
+    // units in the binary need no file access at all
+    {
+        const QString path = QDir::cleanPath(file);
+        QMutexLocker locker(&cache->mutex);
+        QHash<QString, QByteArray>::const_iterator it = cache->staticData.constFind(path);
+        if (it != cache->staticData.constEnd()) {
+            QSharedPointer<QmcUnitData> &data = cache->staticUnits[path];
+            if (!data)
+                data = QSharedPointer<QmcUnitData>(new QmcUnitData(*it, QSharedPointer<QFile>(), 0));
+            return data;
+        }
+    }
+
+    const QFileInfo info(file);
+    // path is empty if the file does not exist, opening reports the error
+    const QString path = info.canonicalFilePath();
+    const QDateTime modified = info.lastModified();
+    const qint64 size = info.size();
+
+    if (!path.isEmpty()) {
+        QSharedPointer<QmcUnitData> cached = cache->find(path, modified, size);
+        if (cached)
+            return cached;
+    }
+
+    QByteArray bytes;
+    QSharedPointer<QFile> f;
+    if (!resourceData(file, &bytes)) {
+        f = QSharedPointer<QFile>(new QFile(file));
+        if (!f->open(QFile::ReadOnly)) {
+            *error = f->errorString();
+            return QSharedPointer<QmcUnitData>();
+        }
+        // the last unit using the file may be deleted in any engine thread
+        if (QCoreApplication::instance())
+            f->moveToThread(QCoreApplication::instance()->thread());
+
+        const bool resource = file.startsWith(QLatin1Char(':'));
+        uchar *mapped = mapping && !resource && f->size() > 0 ? f->map(0, f->size()) : NULL;
+        if (mapped) {
+            bytes = QByteArray::fromRawData((const char *)mapped, f->size());
+        } else {
+            bytes = f->readAll();
+            f.clear();
+        }
+    }
+    QSharedPointer<QmcUnitData> data(new QmcUnitData(bytes, f, 0));
+    if (path.isEmpty())
+        return data;
+
+    // another thread may have read the same file meanwhile, first one wins
+    QMutexLocker locker(&cache->mutex);
+    Entry &entry = cache->entries[path];
+    QSharedPointer<QmcUnitData> cached = entry.data.toStrongRef();
+    if (cached && entry.modified == modified && entry.size == size)
+        return cached;
+    entry.modified = modified;
+    entry.size = size;
+    entry.data = data;
+    return data;
+}
+
+QSharedPointer<QmcUnitData> QmcUnitCache::find(const QString &path, const QDateTime &modified, qint64 size)
+{
+    QMutexLocker locker(&mutex);
+    QHash<QString, Entry>::iterator it = entries.find(path);
+    if (it == entries.end())
+        return QSharedPointer<QmcUnitData>();
+    // units still using stale data keep it alive, only the entry goes
+    QSharedPointer<QmcUnitData> data = it->data.toStrongRef();
+    if (!data || it->modified != modified || it->size != size) {
+        entries.erase(it);
+        return QSharedPointer<QmcUnitData>();
+    }
+    return data;
+}
@@ -0,0 +1,90 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+
+#ifndef QMCUNITCACHE_H
+#define QMCUNITCACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+
+#include "qmcpackage.h"
+
+// contents of a unit file shared by all units read from it, in any loader
+// and engine, the file data is never modified, checksums, decompressed
+// sections and position independent code are added by the first unit
+// that needs them
+struct QmcUnitData
+{
+    QmcUnitData(const QByteArray &data, const QSharedPointer<QFile> &mappedFile, qint64 mappedFileOffset,
+                const QSharedPointer<QmcPackagePool> &pool = QSharedPointer<QmcPackagePool>());
+    ~QmcUnitData();
+
+    // either read to memory or mapped from mappedFile at mappedFileOffset,
+    // the file may be shared by units of a package, data is released first
+    const QSharedPointer<QFile> mappedFile;
+    const QByteArray data;
+    const qint64 mappedFileOffset;
+    // pool of the package the data is in, NULL for files
+    const QSharedPointer<QmcPackagePool> pool;
+
+    QMutex mutex; // guards the rest
+    QSet<int> checkedSections;
+    // decompressed sections by id, data is used in place from these as well
+    QHash<int, QByteArray> sectionBuffers;
+    // linked position independent code, it refers to no unit or engine
+    void *code;
+    qint64 codeSize;
+};
+
+// process wide cache of unit files, files are identified by canonical path,
+// modification time and size so that changed files are read again, data is
+// released when the last unit read from it is deleted
+class QmcUnitCache
+{
+public:
+    // maps or reads the file unless cached, NULL with error set on failure
+    static QSharedPointer<QmcUnitData> file(const QString &file, bool mapping, QString *error);
+    // data of an uncompressed resource in place, false for anything else
+    static bool resourceData(const QString &file, QByteArray *bytes);
+    // unit compiled into the binary, found by file before the file system
+    static void addStaticUnit(const QString &file, const uchar *data, qint64 size);
+
+private:
+    struct Entry
+    {
+        QDateTime modified;
+        qint64 size;
+        QWeakPointer<QmcUnitData> data;
+    };
+
+    QSharedPointer<QmcUnitData> find(const QString &path, const QDateTime &modified, qint64 size);
+
+    QMutex mutex;
+    QHash<QString, Entry> entries;
+    // static units are never released, their code is linked only once
+    QHash<QString, QByteArray> staticData;
+    QHash<QString, QSharedPointer<QmcUnitData> > staticUnits;
+};
+
+#endif // QMCUNITCACHE_H
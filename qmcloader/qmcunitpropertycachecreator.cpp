@@ -243,8 +243,6 @@ bool QmcUnitPropertyCacheCreator::createMetaObject(int objectIndex, const QV4::C
     int aliasCount = 0;
     int varPropCount = 0;
 
-    QmlIR::PropertyResolver resolver(baseTypeCache);
-
     const QV4::CompiledData::Property* propertyTable = obj->propertyTable();
     for (unsigned int i = 0; i < obj->nProperties; i++) {
         const QV4::CompiledData::Property* p = &propertyTable[i];
@@ -252,22 +250,34 @@ bool QmcUnitPropertyCacheCreator::createMetaObject(int objectIndex, const QV4::C
             aliasCount++;
         else if (p->type == QV4::CompiledData::Property::Var)
             varPropCount++;
+    }
 
-        // No point doing this for both the alias and non alias cases
-        bool notInRevision = false;
-        QQmlPropertyData *d = resolver.property(qmcTypeUnit->stringAt(p->nameIndex), &notInRevision);
-        if (d && d->isFinal()) {
-            recordError(p->location, tr("Cannot override FINAL property"));
-            return false;
+    // meta data from the compiler is used as is while the base type has the
+    // same layout, the overrides were checked by the compiler then
+    const QByteArray *precomputed = precomputedMetaObject(objectIndex, obj, cache, aliasCount, varPropCount);
+
+    if (!precomputed) {
+        QmlIR::PropertyResolver resolver(baseTypeCache);
+        for (unsigned int i = 0; i < obj->nProperties; i++) {
+            const QV4::CompiledData::Property* p = &propertyTable[i];
+            // No point doing this for both the alias and non alias cases
+            bool notInRevision = false;
+            QQmlPropertyData *d = resolver.property(qmcTypeUnit->stringAt(p->nameIndex), &notInRevision);
+            if (d && d->isFinal()) {
+                recordError(p->location, tr("Cannot override FINAL property"));
+                return false;
+            }
         }
     }
 
     typedef QQmlVMEMetaData VMD;
 
-    QByteArray &dynamicData = qmcTypeUnit->vmeMetaObjects[objectIndex] = QByteArray(sizeof(QQmlVMEMetaData)
+    QByteArray &dynamicData = qmcTypeUnit->vmeMetaObjects[objectIndex] = precomputed ? *precomputed : QByteArray(sizeof(QQmlVMEMetaData)
                                                               + obj->nProperties * sizeof(VMD::PropertyData)
                                                               + obj->nFunctions * sizeof(VMD::MethodData)
                                                               + aliasCount * sizeof(VMD::AliasData), 0);
+    // precomputed data is copied out of the file so that it is aligned
+    dynamicData.detach();
 
     int effectivePropertyIndex = cache->propertyIndexCacheStart;
     int effectiveMethodIndex = cache->methodIndexCacheStart;
@@ -277,8 +287,8 @@ bool QmcUnitPropertyCacheCreator::createMetaObject(int objectIndex, const QV4::C
     // and throw an error if there is a signal/method defined as an override.
     QSet<QString> seenSignals;
     seenSignals << QStringLiteral("destroyed") << QStringLiteral("parentChanged") << QStringLiteral("objectNameChanged");
-    QQmlPropertyCache *parentCache = cache;
-    while ((parentCache = parentCache->parent())) {
+    QQmlPropertyCache *parentCache = precomputed ? NULL : cache;
+    while (parentCache && (parentCache = parentCache->parent())) {
         if (int pSigCount = parentCache->signalCount()) {
             int pSigOffset = parentCache->signalOffset();
             for (int i = pSigOffset; i < pSigCount; ++i) {
@@ -364,7 +374,8 @@ bool QmcUnitPropertyCacheCreator::createMetaObject(int objectIndex, const QV4::C
             }
         }
 
-        ((QQmlVMEMetaData *)dynamicData.data())->signalCount++;
+        if (!precomputed)
+            ((QQmlVMEMetaData *)dynamicData.data())->signalCount++;
 
         quint32 flags = QQmlPropertyData::IsSignal | QQmlPropertyData::IsFunction |
                         QQmlPropertyData::IsVMESignal;
@@ -420,6 +431,7 @@ bool QmcUnitPropertyCacheCreator::createMetaObject(int objectIndex, const QV4::C
     // Dynamic properties (except var and aliases)
     int effectiveSignalIndex = cache->signalHandlerIndexCacheStart;
     int propertyIdx = 0;
+    int vmePropertyIdx = 0;
     for (; propertyIdx < (int)obj->nProperties; ++propertyIdx) {
         const QV4::CompiledData::Property* p = &propertyTable[propertyIdx];
         if (p->type == QV4::CompiledData::Property::Alias ||
@@ -490,9 +502,12 @@ bool QmcUnitPropertyCacheCreator::createMetaObject(int objectIndex, const QV4::C
 
         effectiveSignalIndex++;
 
+        // types are set in precomputed data too, list types are registered
+        // at run time
         VMD *vmd = (QQmlVMEMetaData *)dynamicData.data();
-        (vmd->propertyData() + vmd->propertyCount)->propertyType = vmePropertyType;
-        vmd->propertyCount++;
+        (vmd->propertyData() + vmePropertyIdx++)->propertyType = vmePropertyType;
+        if (!precomputed)
+            vmd->propertyCount++;
     }
 
     // Now do var properties
@@ -507,10 +522,12 @@ bool QmcUnitPropertyCacheCreator::createMetaObject(int objectIndex, const QV4::C
         if (!p->flags & QV4::CompiledData::Property::IsReadOnly)
             propertyFlags |= QQmlPropertyData::IsWritable;
 
-        VMD *vmd = (QQmlVMEMetaData *)dynamicData.data();
-        (vmd->propertyData() + vmd->propertyCount)->propertyType = QMetaType::QVariant;
-        vmd->propertyCount++;
-        ((QQmlVMEMetaData *)dynamicData.data())->varPropertyCount++;
+        if (!precomputed) {
+            VMD *vmd = (QQmlVMEMetaData *)dynamicData.data();
+            (vmd->propertyData() + vmd->propertyCount)->propertyType = QMetaType::QVariant;
+            vmd->propertyCount++;
+            ((QQmlVMEMetaData *)dynamicData.data())->varPropertyCount++;
+        }
 
         QString propertyName = qmcTypeUnit->stringAt(p->nameIndex);
         if (propertyIdx == obj->indexOfDefaultProperty) cache->_defaultPropertyName = propertyName;
@@ -520,6 +537,9 @@ bool QmcUnitPropertyCacheCreator::createMetaObject(int objectIndex, const QV4::C
         effectiveSignalIndex++;
     }
 
+    if (precomputed)
+        return true;
+
     // Alias property count.  Actual data is setup in buildDynamicMetaAliases
     ((QQmlVMEMetaData *)dynamicData.data())->aliasCount = aliasCount;
     // Dynamic slot data - comes after the property data
@@ -537,3 +557,30 @@ bool QmcUnitPropertyCacheCreator::createMetaObject(int objectIndex, const QV4::C
     }
     return true;
 }
+
+const QByteArray *QmcUnitPropertyCacheCreator::precomputedMetaObject(int objectIndex, const QV4::CompiledData::Object *obj,
+                                                                     const QQmlPropertyCache *cache, int aliasCount, int varPropCount)
+{
+    QHash<int, QmcUnitMetaObject>::const_iterator metaObject = qmcUnit->metaObjects.constFind(objectIndex);
+    if (metaObject == qmcUnit->metaObjects.constEnd())
+        return NULL;
+
+    // base type has changed since compiling
+    if (metaObject->propertyIndexCacheStart != quint32(cache->propertyIndexCacheStart)
+            || metaObject->methodIndexCacheStart != quint32(cache->methodIndexCacheStart)
+            || metaObject->signalHandlerIndexCacheStart != quint32(cache->signalHandlerIndexCacheStart))
+        return NULL;
+
+    // data must describe the object, it may not be aligned in the file
+    typedef QQmlVMEMetaData VMD;
+    const QByteArray &data = metaObject->data;
+    if (data.size() != int(sizeof(VMD) + obj->nProperties * sizeof(VMD::PropertyData)
+                           + obj->nFunctions * sizeof(VMD::MethodData) + aliasCount * sizeof(VMD::AliasData)))
+        return NULL;
+    VMD vmd;
+    memcpy(&vmd, data.constData(), sizeof(VMD));
+    if (vmd.propertyCount != int(obj->nProperties) - aliasCount || vmd.varPropertyCount != varPropCount
+            || vmd.aliasCount != aliasCount || vmd.signalCount != int(obj->nSignals) || vmd.methodCount != int(obj->nFunctions))
+        return NULL;
+    return &data;
+}
@@ -39,6 +39,8 @@ private:
     bool buildMetaObjectRecursively(int objectIndex, int referencingObjectIndex, const QV4::CompiledData::Binding *instantiatingBinding);
     bool createMetaObject(int objectIndex, const QV4::CompiledData::Object *obj, QQmlPropertyCache *baseTypeCache);
     bool ensureMetaObject(int objectIndex);
+    const QByteArray *precomputedMetaObject(int objectIndex, const QV4::CompiledData::Object *obj, const QQmlPropertyCache *cache,
+                                            int aliasCount, int varPropCount);
     void recordError(const QV4::CompiledData::Location &location, const QString &description);
     QString tr(QString);
     quint32 objectCount();
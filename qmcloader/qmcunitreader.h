@@ -0,0 +1,169 @@
+/*!
+ * Copyright (C) 2014 Nomovok Ltd. All rights reserved.
+ * Contact: info@nomovok.com
+ *
+ * This file may be used under the terms of the GNU Lesser
+ * General Public License version 2.1 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.LGPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU Lesser General Public License version 2.1 requirements
+ * will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+ *
+ * In addition, as a special exception, copyright holders
+ * give you certain additional rights.  These rights are described in
+ * the Digia Qt LGPL Exception version 1.1, included in the file
+ * LGPL_EXCEPTION.txt in this package.
+ */
+
+#ifndef QMCUNITREADER_H
+#define QMCUNITREADER_H
+
+#include <QVector>
+
+#include <string.h>
+
+#include "qmcvarint.h"
+
+// reads qmc unit data in place from memory (file mapping or buffer)
+// all reads are bounds checked, aligned reads are done only if the
+// unit has been written with QMC_UNIT_FLAG_ALIGNED
+class QmcUnitReader
+{
+public:
+    QmcUnitReader(const char *data, qint64 size)
+        : data(data),
+          dataSize(size),
+          pos(0),
+          aligned(false)
+    {
+    }
+
+    void setAligned(bool aligned) { this->aligned = aligned; }
+    qint64 position() const { return pos; }
+    qint64 size() const { return dataSize; }
+    qint64 remaining() const { return pos < dataSize ? dataSize - pos : 0; }
+
+    // counts in the file are only limited by the size of the data, count
+    // records of at least recordSize bytes must fit in the remaining data
+    // before anything is allocated for them
+    bool canRead(quint64 count, qint64 recordSize) const
+    {
+        return count <= quint64(remaining() / recordSize);
+    }
+
+    // returns pointer to data inside the buffer, NULL if out of bounds
+    const char *readInPlace(qint64 len, int alignment = 1)
+    {
+        if (aligned && alignment > 1)
+            pos = (pos + alignment - 1) & ~qint64(alignment - 1);
+        if (len < 0 || pos > dataSize || len > dataSize - pos)
+            return NULL;
+        const char *p = data + pos;
+        pos += len;
+        return p;
+    }
+
+    bool read(void *dst, qint64 len, int alignment = 1)
+    {
+        const char *p = readInPlace(len, alignment);
+        if (!p)
+            return false;
+        memcpy(dst, p, len);
+        return true;
+    }
+
+    template <typename T>
+    bool read(T &value)
+    {
+        return read(&value, sizeof(T), Q_ALIGNOF(T));
+    }
+
+    bool readVarint(quint32 &value)
+    {
+        const char *p = readInPlace(0);
+        if (!p)
+            return false;
+        const int n = QmcVarint::decode((const uchar *)p, remaining(), &value);
+        return n > 0 && readInPlace(n);
+    }
+
+private:
+    const char *data;
+    qint64 dataSize;
+    qint64 pos;
+    bool aligned;
+};
+
+// table of fixed size records read in place from unit data, records are
+// copied only if they are not properly aligned in the buffer
+template <typename T>
+class QmcUnitTable
+{
+public:
+    typedef const T *const_iterator;
+
+    QmcUnitTable()
+        : d(NULL),
+          n(0)
+    {
+    }
+
+    bool read(QmcUnitReader &reader, quint32 count)
+    {
+        if (count == 0) {
+            d = NULL;
+            n = 0;
+            return true;
+        }
+        if (!reader.canRead(count, sizeof(T)))
+            return false;
+        const char *p = reader.readInPlace(qint64(count) * sizeof(T), Q_ALIGNOF(T));
+        if (!p)
+            return false;
+        n = count;
+        if (quintptr(p) % Q_ALIGNOF(T)) {
+            copy.resize(count);
+            memcpy(copy.data(), p, count * sizeof(T));
+            d = copy.constData();
+        } else
+            d = reinterpret_cast<const T *>(p);
+        return true;
+    }
+
+    // records of quint32 fields encoded with QmcVarint::appendTable, these
+    // are always decoded to a copy
+    bool readCompact(QmcUnitReader &reader, quint32 count, quint32 deltaMask)
+    {
+        d = NULL;
+        n = 0;
+        if (count == 0)
+            return true;
+        const int fields = sizeof(T) / sizeof(quint32);
+        if (!reader.canRead(count, fields))
+            return false;
+        copy.resize(count);
+        const char *p = reader.readInPlace(0);
+        const qint64 len = QmcVarint::decodeTable((const uchar *)p, reader.remaining(),
+                                                  (quint32 *)copy.data(), count, fields, deltaMask);
+        if (len < 0 || !reader.readInPlace(len))
+            return false;
+        n = count;
+        d = copy.constData();
+        return true;
+    }
+
+    int size() const { return n; }
+    bool isEmpty() const { return n == 0; }
+    const T &at(int i) const { Q_ASSERT(i >= 0 && i < n); return d[i]; }
+    const T &operator[](int i) const { return at(i); }
+    const T *constData() const { return d; }
+    const_iterator begin() const { return d; }
+    const_iterator end() const { return d + n; }
+
+private:
+    const T *d;
+    int n;
+    QVector<T> copy;
+};
+
+#endif // QMCUNITREADER_H